@@ -1,138 +1,307 @@
 #include "backtrack.h"
 #include "puzzle.h"
-#include "iter.h"
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 #include "debug.h"
 #include "strategy.h"
+#include "board.h"
+#include "dlx.h"
 #include "constants.h"
 
-struct step {
-    uint8_t x;
-    uint8_t y;
-    puzzle p;
+const struct search_opts search_defaults = {
+    NULL, BRANCH_MRV_DEGREE, 0, VALUE_ASCENDING, ENGINE_LOGIC, NULL, NULL,
+    NULL
 };
 
-int _next_possibility(uint16_t pencil, int last) {
-    int next = pencil >> last;
-    if (next) {
-        next = __builtin_ffs(next) + last;
-        assert(next > last);
+const char *search_engine_names[] = { "logic", "dlx", NULL };
+
+void search_opts_init(struct search_opts *opts) {
+    *opts = search_defaults;
+}
+
+struct workspace *workspace_new(void) {
+    struct workspace *ws = malloc(sizeof *ws);
+    if (ws) {
+        memset(&ws->arenas, 0, sizeof ws->arenas);
+        if (!dlx_arenas_reserve(&ws->arenas, 3)) {
+            workspace_free(ws);
+            return NULL;
+        }
+    }
+    return ws;
+}
+
+void workspace_free(struct workspace *ws) {
+    if (ws) {
+        dlx_arenas_free(&ws->arenas);
+        free(ws);
+    }
+}
+
+/* look up an engine by the name the command line knows it by, or -1 */
+int search_engine_by_name(const char *name) {
+    for (int i = 0; search_engine_names[i]; i++) {
+        if (strcmp(search_engine_names[i], name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* cells with no possibilities are only ever seen on an inconsistent board,
+ * so the candidate buckets from 1 up cover every cell worth branching on */
+struct bitboard _unfilled(struct board *b) {
+    struct bitboard all = b->by_count[0];
+    for (int k = 1; k <= GROUP_LENGTH; k++) {
+        all = bb_or(all, b->by_count[k]);
+    }
+    return all;
+}
+
+/* pick the cell to branch on, and report how many candidates it has */
+int _choose_cell(struct board *b, enum branch_rule rule, int *count) {
+    if (rule == BRANCH_SCAN) {
+        int cell = bb_first(_unfilled(b));
+        *count = hamming_weight(b->grid[CELL_X(cell)][CELL_Y(cell)].u.pencil);
+        return cell;
+    }
+    int k = 1;
+    while (bb_empty(b->by_count[k])) {
+        k++;
+        assert(k <= GROUP_LENGTH);
+    }
+    *count = k;
+    struct bitboard bucket = b->by_count[k];
+    int best = bb_pop(&bucket);
+    if (rule == BRANCH_MRV_DEGREE && !bb_empty(bucket)) {
+        /* break ties by the number of unfilled peers, as filling the cell
+         * with the most unfilled peers constrains the board the most */
+        struct bitboard unfilled = _unfilled(b);
+        int best_degree = bb_count(bb_and(peer_bb[best], unfilled));
+        while (!bb_empty(bucket)) {
+            int cell = bb_pop(&bucket);
+            int degree = bb_count(bb_and(peer_bb[cell], unfilled));
+            if (degree > best_degree) {
+                best = cell;
+                best_degree = degree;
+            }
+        }
+    }
+    return best;
+}
+
+/* the fewest places any unplaced digit has left in any unit, if that is
+ * fewer than limit. returns the unit, or -1 if there is none */
+int _choose_unit(struct board *b, int limit, int *digit) {
+    int best = -1;
+    for (int u = 0; u < UNIT_COUNT && limit > 2; u++) {
+        uint16_t missing = ALL_POS & ~b->placed[u / 9][u % 9];
+        while (missing) {
+            int d = __builtin_ctz(missing);
+            missing &= missing - 1;
+            int places = bb_count(bb_and(b->cand[d], unit_bb[u]));
+            if (places < limit) {
+                limit = places;
+                best = u;
+                *digit = d + 1;
+            }
+        }
+    }
+    return best;
+}
+
+/* order the digits of a cell so that those which rule out the fewest
+ * possibilities among the cell's peers are tried first */
+void _order_least_constraining(struct board *b, struct step *s) {
+    int score[GROUP_LENGTH];
+    for (int i = 0; i < s->n; i++) {
+        score[i] = bb_count(bb_and(b->cand[s->alt[i] - 1], peer_bb[s->cell]));
+        for (int j = i; j > 0 && score[j - 1] > score[j]; j--) {
+            int t = score[j];
+            score[j] = score[j - 1];
+            score[j - 1] = t;
+            t = s->alt[j];
+            s->alt[j] = s->alt[j - 1];
+            s->alt[j - 1] = t;
+        }
+    }
+}
+
+void _order_random(struct rng *rng, struct step *s) {
+    for (int i = s->n - 1; i > 0; i--) {
+        int j = rng_below(rng, i + 1);
+        int t = s->alt[i];
+        s->alt[i] = s->alt[j];
+        s->alt[j] = t;
+    }
+}
+
+/* set up a step to branch on the board as it stands */
+void _choose(struct board *b, const struct search_opts *opts, struct step *s) {
+    int count;
+    int cell = _choose_cell(b, opts->branch, &count);
+    if (b->stats) {
+        b->stats->guesses++;
+    }
+    int digit;
+    int unit = opts->unit_branching ? _choose_unit(b, count, &digit) : -1;
+    s->mark = b->trail->len;
+    s->next = 0;
+    s->n = 0;
+    if (unit >= 0) {
+        struct bitboard places = bb_and(b->cand[digit - 1], unit_bb[unit]);
+        s->digit = digit;
+        while (!bb_empty(places)) {
+            s->alt[s->n++] = bb_pop(&places);
+        }
+        dprintf("branching on %d in %s %d\n", digit,
+                unit_type_names[unit / 9], unit % 9);
     } else {
-        next = 0;
+        uint16_t pencil = b->grid[CELL_X(cell)][CELL_Y(cell)].u.pencil;
+        s->cell = cell;
+        s->digit = BY_CELL;
+        while (pencil) {
+            s->alt[s->n++] = __builtin_ctz(pencil) + 1;
+            pencil &= pencil - 1;
+        }
+        if (opts->order == VALUE_LEAST_CONSTRAINING) {
+            _order_least_constraining(b, s);
+        }
+        dprintf("branching on cell %d\n", cell);
+    }
+    if (opts->order == VALUE_RANDOM) {
+        _order_random(opts->rng, s);
     }
-    return next;
 }
 
-int _fill_cell(puzzle puz, struct step **stack, int x, int y, int last_guess) {
-    int next = _next_possibility(puz[x][y].u.pencil, last_guess);
-    assert(next >= 0 && next <= 9);
-    if (next == 0) {
+/* restore the board from before the step's guess, and make the step's next
+ * guess. returns 0 if there are none left to try */
+int _fill_cell(struct board *b, struct step *s) {
+    board_undo(b, s->mark);
+    if (s->next == s->n) {
         return 0;
+    }
+    int alt = s->alt[s->next++];
+    if (s->digit == BY_CELL) {
+        dprintf("trying %d at %d\n", alt, s->cell);
+        board_fill_cell(b, s->cell, alt);
     } else {
-        struct step *s = *stack;
-        assert(0 <= x && x < 9);
-        assert(0 <= y && y < 9);
-        s->x = x;
-        s->y = y;
-        puzzle_copy(puz, s->p);
-        *stack = ++s;
-        puzzle_fill_cell(puz, x, y, next);
-        dprintf("trying %d next\n", next);
-        dprintf("last = %d, next = %d\n", last_guess, next);
-        puzzle_dprint(puz);
-        return next;
-    }
-}
-
-int _consistent(puzzle puz, int x, int y) {
-    struct iter it;
-    dprintf("row %d\n", y);
-    iter_init(&it, ROW, y);
-    if (!iter_consistent(&it, puz)) return 0;
-    dprintf("col %d\n", x);
-    iter_init(&it, COL, x);
-    if (!iter_consistent(&it, puz)) return 0;
-    dprintf("box\n");
-    iter_init(&it, BOX, (y / 3) * 3 + x / 3);
-    if (!iter_consistent(&it, puz)) return 0;
+        dprintf("trying %d at %d\n", s->digit, alt);
+        board_fill_cell(b, alt, s->digit);
+    }
+    puzzle_dprint(b->grid);
     return 1;
 }
 
-int _next_unfilled(puzzle puz, int *x, int *y) {
-    int d = *y * 9 + *x;
-    UNUSED(d);
-    while (*x < 9 && *y < 9 && puz[*x][*y].complete) {
-        (*x)++;
-        *y += *x / 9;
-        *x %= 9;
+int _search_logic(struct board *b) {
+    if (b->stats) {
+        b->stats->nodes++;
+    }
+    return board_logic(b);
+}
+
+/* the filled cells of the board as it was at a mark of its trail: the
+ * board as it stands, less every cell filled since */
+void _cells_at(struct board *b, int mark, uint8_t *cells) {
+    for (int i = 0; i < BOARD_LENGTH; i++) {
+        struct cell *c = &b->grid[CELL_X(i)][CELL_Y(i)];
+        cells[i] = c->complete ? c->u.ink : 0;
+    }
+    for (int i = mark; i < b->trail->len; i++) {
+        if (b->trail->entries[i].fill) {
+            cells[b->trail->entries[i].cell] = 0;
+        }
     }
-    assert(d <= *y * 9 + *x);
-    return *x < 9 && *y < 9;
 }
 
-int _run_backtrack(puzzle puz, struct step * const stack, struct step **stackpp, int *x, int *y, int last_tried) {
+/* give away work (see solutions.h): the untried alternatives of the
+ * shallowest guess which has any, or with all, those of every guess,
+ * followed by the board itself if it is live */
+void _give_away(struct board *b, struct step *stack, struct step *stackp,
+                const struct solutions *out, int all, int live) {
+    uint8_t cells[BOARD_LENGTH];
+    for (struct step *s = stack; s < stackp; s++) {
+        if (s->next == s->n) {
+            continue;
+        }
+        _cells_at(b, s->mark, cells);
+        for (int j = s->n - 1; j >= s->next; j--) {
+            int cell = s->digit == BY_CELL ? s->cell : s->alt[j];
+            cells[cell] = s->digit == BY_CELL ? s->alt[j] : s->digit;
+            out->give(cells, out->arg);
+            cells[cell] = 0;
+        }
+        s->next = s->n;
+        if (!all) {
+            return;
+        }
+    }
+    if (all && live) {
+        _cells_at(b, b->trail->len, cells);
+        out->give(cells, out->arg);
+    }
+}
+
+/* search for the next solution, starting from the board left by the last
+ * call (or the initial board, when the stack is empty). if resume is set,
+ * the board holds a solution which has already been reported, so we back
+ * up straight away. returns 1 with a solution in b, or 0 once the search
+ * space is exhausted, or the search is cancelled or has given all its work
+ * away */
+int _run_backtrack(struct board *b, const struct search_opts *opts,
+                   struct step * const stack, struct step **stackpp,
+                   int resume) {
     struct step *stackp = *stackpp;
-    assert(last_tried >= 0 && last_tried <= 9);
+    int res = resume ? INCONSISTENT : _search_logic(b);
     while (1) {
-        dprintf("s = %ld, x = %d, y = %d\n", stackp - stack, *x, *y);
-        if (puzzle_logic(puz) != INCONSISTENT) {
-            dprintf("consistent\n");
-            if (!_next_unfilled(puz, x, y)) {
+        dprintf("s = %ld\n", (long) (stackp - stack));
+        if (solutions_cancelled(opts->solutions)) {
+            *stackpp = stackp;
+            return 0;
+        }
+        int split = solutions_wanted(opts->solutions);
+        if (split != SPLIT_NONE) {
+            _give_away(b, stack, stackp, opts->solutions, split == SPLIT_ALL,
+                       res != INCONSISTENT);
+            if (split == SPLIT_ALL) {
+                *stackpp = stack;
+                return 0;
+            }
+        }
+        if (res != INCONSISTENT) {
+            if (b->unfilled == 0) {
                 dprintf("done\n");
                 *stackpp = stackp;
                 return 1;
-            } else {
-                assert(!puz[*x][*y].complete);
-                dprintf("progressing\n");
-                dprintf("before: %ld", stackp - stack);
-                if (!(last_tried = _fill_cell(puz, &stackp, *x, *y, 0))) {
-                    dprintf("non-initial fill failed\n");
-                    return 0;
-                }
-                assert(last_tried >= 1 && last_tried <= 9);
-                dprintf(", after: %ld\n", stackp - stack);
+            }
+            _choose(b, opts, stackp);
+            /* logic never leaves a cell or a digit without possibilities */
+            if (!_fill_cell(b, stackp)) {
+                assert(0);
+            }
+            stackp++;
+            if (b->stats && (uint64_t) (stackp - stack) > b->stats->max_depth) {
+                b->stats->max_depth = stackp - stack;
             }
         } else {
             dprintf("starting to back up\n");
-            stackp--;
-            do {
-                dprintf("backtracking, s = %ld, x = %d, y = %d\n", stackp - stack, *x, *y);
-
-                /* fill_cell increments stackp, so decrement to get last step
-                 * written and prepare to overwrite the step*/
-                if (stackp < stack) {
-                    /* we have no where to turn back to, so fail out */
-                    dprintf("ran out of options\n");
-                    return 0;
-                }
-                assert(stackp >= stack);
-                assert(stackp->x == *x && stackp->y == *y);
-                last_tried = puz[*x][*y].u.ink;
-                puzzle_copy(stackp->p, puz);
-                puz[*x][*y].complete = 0;
-                puz[*x][*y].u.pencil = stackp->p[*x][*y].u.pencil;
-                assert(last_tried >= 0 && last_tried <= 9);
-                if (last_tried >= 9 || !(last_tried = _fill_cell(puz, &stackp, *x, *y, last_tried))) {
-                    stackp--;
-                    if (stackp < stack) {
-                        return 0;
-                    }
-                    /* we have exhausted options, so we must have guessed badly
-                     * at some point before; therefore, we turn back
-                     * back up even further, to 2 steps ago,
-                     * change coordinates to set up for next round */
-                    *x = stackp->x;
-                    *y = stackp->y;
-                    dprintf("backing up to x = %d, y = %d\n", *x, *y);
-                    assert(*x >= 0 && *x < 9);
-                    assert(*y >= 0 && *y < 9);
-                } else {
-                    assert(last_tried >= 1 && last_tried <= 9);
-                    dprintf("success!\n");
-                    break;
-                }
-            } while(1);
+            /* we have exhausted the options for the latest guess, so we
+             * must have guessed badly at some point before; therefore,
+             * we back up until there is a guess with options left */
+            while (stackp > stack && !_fill_cell(b, stackp - 1)) {
+                stackp--;
+            }
+            if (b->stats) {
+                b->stats->backtracks++;
+            }
+            if (stackp == stack) {
+                dprintf("ran out of options\n");
+                *stackpp = stackp;
+                return 0;
+            }
         }
+        res = _search_logic(b);
     }
 }
 
@@ -140,27 +309,92 @@ int puzzle_backtrack(puzzle puz) {
     return puzzle_solution_count(puz, 1);
 }
 
+/* count the solutions to a puzzle (whose pencil marks must be filled in),
+ * stopping once max have been found. if there is a solution, the first
+ * one found is left in puz. returns SEARCH_NO_MEMORY if the search could
+ * not get a workspace */
 int puzzle_solution_count(puzzle puz, int max) {
-    int stack_size = puzzle_noninked_count(puz);
-    struct step stack[stack_size];
-    struct step *stackp = stack;
-    int solution_count = 0;
-    int x = 0;
-    int y = 0;
-    int last_tried = 0;
-    while (_run_backtrack(puz, stack, &stackp, &x, &y, last_tried) && solution_count < max) {
-        solution_count++;
-        assert(puzzle_is_consistent(puz));
-        assert(puzzle_noninked_count(puz) == 0);
-        if (stackp <= stack) {
-            break;
-        }
-        stackp--;
-        x = stackp->x;
-        y = stackp->y;
-        assert(puz[x][y].complete);
-        last_tried = puz[x][y].u.ink;
-        puzzle_copy(stackp->p, puz);
+    return puzzle_search(puz, max, NULL);
+}
+
+uint64_t _search_in(struct workspace *ws, puzzle puz, uint64_t max,
+                    const struct search_opts *opts) {
+    struct board *b = &ws->board;
+    struct step *stackp = ws->stack;
+    const struct solutions *out = opts->solutions;
+    uint64_t solution_count = 0;
+    board_load(b, puz);
+    ws->trail.len = 0;
+    b->trail = &ws->trail;
+    b->stats = opts->stats;
+    while (solution_count < max &&
+           _run_backtrack(b, opts, ws->stack, &stackp, solution_count > 0)) {
+        assert(puzzle_is_consistent(b->grid));
+        assert(b->unfilled == 0);
+        if (solution_count++ == 0) {
+            puzzle_copy(b->grid, puz);
+        }
+        if (out && out->fn) {
+            uint8_t cells[BOARD_LENGTH];
+            for (int i = 0; i < BOARD_LENGTH; i++) {
+                cells[i] = b->grid[CELL_X(i)][CELL_Y(i)].u.ink;
+            }
+            if (out->fn(cells, out->arg)) {
+                break;
+            }
+        }
     }
     return solution_count;
 }
+
+/* as puzzle_solution_count, with options. a search without a workspace
+ * allocates one of its own for the duration, and returns SEARCH_NO_MEMORY
+ * if it cannot */
+int puzzle_search(puzzle puz, int max, const struct search_opts *opts) {
+    if (max <= 0) {
+        return 0;
+    }
+    if (!opts) {
+        opts = &search_defaults;
+    }
+    if (opts->space || opts->engine == ENGINE_DLX) {
+        uint64_t count = puzzle_enumerate(puz, max, opts);
+        return count == ENUMERATE_NO_MEMORY ? SEARCH_NO_MEMORY : (int) count;
+    }
+    struct search_opts own = *opts;
+    own.space = workspace_new();
+    if (!own.space) {
+        return SEARCH_NO_MEMORY;
+    }
+    int count = puzzle_enumerate(puz, max, &own);
+    workspace_free(own.space);
+    return count;
+}
+
+/* as puzzle_search, for searches which may run past the range of an int:
+ * with opts->solutions, every solution is handed out as it is found (see
+ * solutions.h), so max can be as large as UINT64_MAX, with the search
+ * running until it is exhausted, stopped or cancelled. returns
+ * ENUMERATE_NO_MEMORY if the search needs a workspace of its own, or a
+ * dancing links matrix, and cannot make one */
+uint64_t puzzle_enumerate(puzzle puz, uint64_t max,
+                          const struct search_opts *opts) {
+    if (!opts) {
+        opts = &search_defaults;
+    }
+    if (opts->engine == ENGINE_DLX) {
+        return dlx_search(puz, max, opts->stats,
+                          opts->space ? &opts->space->arenas : NULL,
+                          opts->solutions);
+    }
+    if (opts->space) {
+        return _search_in(opts->space, puz, max, opts);
+    }
+    struct workspace *ws = workspace_new();
+    if (!ws) {
+        return ENUMERATE_NO_MEMORY;
+    }
+    uint64_t count = _search_in(ws, puz, max, opts);
+    workspace_free(ws);
+    return count;
+}
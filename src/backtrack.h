@@ -2,8 +2,99 @@
 #define __BACKTRACK_H__
 
 #include "cell.h"
+#include "stats.h"
+#include "rng.h"
+#include "board.h"
+#include "dlx.h"
 
+/* how to pick the cell to guess at once logic runs dry:
+ * BRANCH_SCAN:       the first unfilled cell in row major order
+ * BRANCH_MRV:        a cell with the fewest possibilities left
+ * BRANCH_MRV_DEGREE: as BRANCH_MRV, breaking ties in favour of the cell
+ *                    with the most unfilled peers */
+enum branch_rule { BRANCH_SCAN, BRANCH_MRV, BRANCH_MRV_DEGREE };
+
+/* the order in which a cell's digits (or a digit's places) are guessed;
+ * VALUE_RANDOM shuffles them with the options' rng */
+enum value_order { VALUE_ASCENDING, VALUE_LEAST_CONSTRAINING, VALUE_RANDOM };
+
+/* the solver behind puzzle_search:
+ * ENGINE_LOGIC: the strategies, with a backtracking search once they run dry
+ * ENGINE_DLX:   an exact cover search with dancing links (see dlx.h), which
+ *               has no logic to speak of, but very cheap steps; only stats
+ *               are used out of the rest of the options */
+enum search_engine { ENGINE_LOGIC, ENGINE_DLX };
+
+extern const char *search_engine_names[];
+
+/* returned by puzzle_search, in place of a count, when the search needed a
+ * workspace of its own and could not make one */
+#define SEARCH_NO_MEMORY -1
+/* and by puzzle_enumerate */
+#define ENUMERATE_NO_MEMORY DLX_NO_MEMORY
+
+/* a guess. a step either tries each possible digit in one cell, or, when
+ * that is a shorter list, each place left for one digit within a unit;
+ * either way the alternatives are exhaustive and mutually exclusive, so
+ * counting stays exact. rather than a copy of the board from before the
+ * guess, a step keeps the length of the board's trail at that point, and
+ * backing up is done by undoing the trail back to it */
+#define BY_CELL 0xff
+
+struct step {
+    uint8_t cell; /* the cell guessed at, when branching by cell */
+    uint8_t digit; /* the digit placed, or BY_CELL when branching by cell */
+    uint8_t n; /* number of alternatives */
+    uint8_t next; /* index of the next alternative to try */
+    uint8_t alt[GROUP_LENGTH]; /* digits for the cell, or cells for the digit */
+    uint16_t mark;
+};
+
+/* the memory a search works in: the board with its trail and stack of
+ * guesses (every guess fills at least one cell, so there are never more
+ * than BOARD_LENGTH), the dancing links matrices, and counters for callers
+ * which count a search of their own making, such as the rater. together
+ * they run to tens of kilobytes, which is too much to put on the stack of
+ * every call, so a workspace is made once for each thread which solves,
+ * and used for puzzle after puzzle; each search starts by resetting what
+ * it uses, and nothing is freed until workspace_free. the 9x9 matrix is
+ * allocated with the workspace, so that searches in it with dancing links
+ * cannot run out of memory. only one search can use a workspace at a
+ * time */
+struct workspace {
+    struct board board;
+    struct trail trail;
+    struct step stack[BOARD_LENGTH];
+    struct stats stats;
+    struct dlx_arenas arenas;
+};
+
+/* optional knobs for a search; a NULL struct search_opts * means defaults,
+ * and search_opts_init fills one in with the defaults */
+struct search_opts {
+    struct stats *stats; /* if not NULL, solver counters are added here */
+    enum branch_rule branch;
+    int unit_branching; /* instead guess where a digit goes in a unit, when
+                           it has fewer places left than the cell has digits */
+    enum value_order order;
+    enum search_engine engine;
+    struct rng *rng; /* for VALUE_RANDOM */
+    struct workspace *space; /* if NULL, one is made for the search */
+    const struct solutions *solutions; /* if not NULL, where the solutions
+                                          go, and whether to stop */
+};
+
+extern const struct search_opts search_defaults;
+
+void search_opts_init(struct search_opts *opts);
+struct workspace *workspace_new(void);
+void workspace_free(struct workspace *ws);
+int search_engine_by_name(const char *name);
 int puzzle_backtrack(puzzle puz);
 int puzzle_solution_count(puzzle puz, int max_solutions);
+int puzzle_search(puzzle puz, int max_solutions,
+                  const struct search_opts *opts);
+uint64_t puzzle_enumerate(puzzle puz, uint64_t max_solutions,
+                          const struct search_opts *opts);
 
 #endif
@@ -0,0 +1,418 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "batch.h"
+#include "pseudoku.h"
+#include "pool.h"
+
+/* puzzles in flight per worker thread in parallel batch mode */
+#define BATCH_WINDOW_PER_THREAD 64
+
+/* batch mode streams puzzles in the single line format through the solver,
+ * writing one compact result line per input line, in input order:
+ *
+ * solve:  the solved grid, or "inconsistent" if there is no solution
+ * unique: the input grid followed by the number of solutions found,
+ *         where 2 means "two or more"
+ * rate:   the input grid followed by its rating (see rating_format)
+ *
+ * grids of other sizes are solved and counted the same way, with the
+ * dancing links engine, whatever engine was asked for; they cannot be
+ * rated, and produce "unsupported".
+ *
+ * the input can also be a packed corpus (see pseudoku.h), whose records
+ * all hold 9x9 grids.
+ *
+ * lines which cannot be parsed produce "invalid". a throughput summary is
+ * written to stderr once the input is exhausted.
+ *
+ * generating runs the same pipeline with a run of consecutive seeds in
+ * place of the input, writing one new puzzle per seed. puzzle i of a run
+ * from seed s is the puzzle for seed s + i, so any part of a stream can be
+ * reproduced on its own, and with any number of threads. given a grade
+ * band, each line is the puzzle and its rating, or "unreachable" if no
+ * puzzle in the band came of the seed. when split, the
+ * puzzles are instead generated one at a time, each spread over all of
+ * the threads, which cuts the time to get each puzzle rather than the time
+ * for the whole run.
+ *
+ * with more than one thread, the work is a three stage pipeline: the
+ * calling thread reads puzzles into a ring of slots, the slots are solved
+ * by a work stealing pool, and a writer thread drains the ring in order.
+ * the ring doubles as the reorder buffer, and because the reader cannot
+ * get more than a ring's length ahead of the writer, a slow consumer or a
+ * very hard puzzle throttles the reader instead of growing memory.
+ *
+ * batch mode is a client of the library (see pseudoku.h), like any other:
+ * each worker has its own context, and their counters are summed at the
+ * end */
+
+/* one puzzle's worth of work: a grid of any size read from the input, a
+ * record of a packed corpus still to be unpacked, or a seed to generate
+ * from */
+struct batch_item {
+    uint8_t cells[PSEUDOKU_CELLS_MAX];
+    int box; /* 0 for a line or record which is not a grid */
+    const uint8_t *record;
+    uint64_t seed;
+};
+
+struct batch_slot {
+    struct batch *batch;
+    struct batch_item item;
+    int done;
+    int len;
+    char line[BATCH_LINE_MAX];
+};
+
+/* where the work comes from: lines read from a file, the records of a
+ * packed corpus, or, when generating, a run of seeds */
+struct batch_input {
+    FILE *in;
+    const struct pseudoku_corpus *corpus;
+    uint64_t seed; /* or the next record */
+    unsigned long remaining;
+};
+
+struct batch {
+    const struct batch_opts *bopts;
+    enum batch_mode mode;
+    FILE *out;
+    struct batch_slot *slots;
+    struct pseudoku **ctx; /* one per worker */
+    unsigned long window;
+    unsigned long head; /* next slot to be written */
+    unsigned long tail; /* next slot to be read into */
+    unsigned long invalid;
+    int eof;
+    pthread_mutex_t lock;
+    pthread_cond_t space;
+    pthread_cond_t ready;
+};
+
+double _batch_elapsed(struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* fetch the next piece of work into an item. returns 0 once there is no
+ * more */
+int _batch_next(enum batch_mode mode, struct batch_input *input,
+                struct batch_item *item) {
+    item->record = NULL;
+    if (mode == BATCH_GENERATE || input->corpus) {
+        if (!input->remaining) {
+            return 0;
+        }
+        input->remaining--;
+        if (input->corpus) {
+            item->record = pseudoku_corpus_record(input->corpus,
+                                                  input->seed++);
+        } else {
+            item->seed = input->seed++;
+        }
+        item->box = 3;
+        return 1;
+    }
+    int box = pseudoku_read(input->in, item->cells);
+    item->box = box > 0 ? box : 0;
+    return box != 0;
+}
+
+/* do the work for an item on a context, and format its result line into
+ * line, which must hold at least BATCH_LINE_MAX characters. returns the
+ * length of the line */
+int _batch_work(const struct batch_opts *bopts, enum batch_mode mode,
+                struct pseudoku *ctx, struct batch_item *item, char *line) {
+    int len = 0;
+    if (item->record && !pseudoku_unpack(item->record, item->cells)) {
+        item->box = 0;
+    }
+    if (!item->box) {
+        strcpy(line, "invalid");
+        len = strlen(line);
+    } else if (mode == BATCH_GENERATE && bopts->graded) {
+        if (pseudoku_generate_graded(ctx, item->seed, bopts->grade_lo,
+                                     bopts->grade_hi, item->cells, NULL,
+                                     line + BOARD_CELLS + 1)) {
+            pseudoku_format(3, item->cells, line);
+            line[BOARD_CELLS] = ' ';
+            len = BOARD_CELLS + 1 + strlen(line + BOARD_CELLS + 1);
+        } else {
+            strcpy(line, "unreachable");
+            len = strlen(line);
+        }
+    } else if (mode == BATCH_GENERATE) {
+        pseudoku_generate(ctx, item->seed, item->cells);
+        len = pseudoku_format(3, item->cells, line);
+    } else if (mode == BATCH_SOLVE) {
+        int res = pseudoku_solve(ctx, item->box, item->cells);
+        if (res == 1) {
+            len = pseudoku_format(item->box, item->cells, line);
+        } else {
+            strcpy(line, res == PSEUDOKU_NO_MEMORY ? "out of memory" :
+                                                     "inconsistent");
+            len = strlen(line);
+        }
+    } else if (mode == BATCH_UNIQUE) {
+        int found = pseudoku_count(ctx, item->box, item->cells, 2);
+        if (found == PSEUDOKU_NO_MEMORY) {
+            strcpy(line, "out of memory");
+            len = strlen(line);
+        } else {
+            len = pseudoku_format(item->box, item->cells, line);
+            line[len++] = ' ';
+            line[len++] = '0' + found;
+        }
+    } else if (item->box != 3) {
+        /* only 9x9 grids can be rated */
+        strcpy(line, "unsupported");
+        len = strlen(line);
+    } else {
+        len = pseudoku_format(item->box, item->cells, line);
+        line[len++] = ' ';
+        pseudoku_rate(ctx, item->cells, NULL, line + len);
+        len += strlen(line + len);
+    }
+    line[len++] = '\n';
+    line[len] = '\0';
+    return len;
+}
+
+void _batch_solve_slot(void *arg, int worker) {
+    struct batch_slot *slot = arg;
+    struct batch *b = slot->batch;
+    slot->len = _batch_work(b->bopts, b->mode, b->ctx[worker], &slot->item,
+                            slot->line);
+    pthread_mutex_lock(&b->lock);
+    slot->done = 1;
+    if (slot == &b->slots[b->head % b->window]) {
+        pthread_cond_signal(&b->ready);
+    }
+    pthread_mutex_unlock(&b->lock);
+}
+
+void *_batch_writer(void *arg) {
+    struct batch *b = arg;
+    pthread_mutex_lock(&b->lock);
+    while (1) {
+        struct batch_slot *slot = &b->slots[b->head % b->window];
+        while (!(b->head < b->tail && slot->done) &&
+               !(b->eof && b->head == b->tail)) {
+            pthread_cond_wait(&b->ready, &b->lock);
+        }
+        if (b->head == b->tail) {
+            break;
+        }
+        pthread_mutex_unlock(&b->lock);
+        fwrite(slot->line, 1, slot->len, b->out);
+        pthread_mutex_lock(&b->lock);
+        /* counted here rather than by the reader, since a packed record is
+         * only found to be bad once it is unpacked */
+        b->invalid += !slot->item.box;
+        b->head++;
+        pthread_cond_signal(&b->space);
+    }
+    pthread_mutex_unlock(&b->lock);
+    return NULL;
+}
+
+/* returns 0, before reading anything, if the pool or the writer cannot be
+ * started */
+int _batch_run_parallel(const struct batch_opts *bopts, enum batch_mode mode,
+                        struct pseudoku **ctx, struct batch_input *in,
+                        FILE *out, int threads, unsigned long *count,
+                        unsigned long *invalid) {
+    struct batch b;
+    struct pool pool;
+    pthread_t writer;
+    b.mode = mode;
+    b.bopts = bopts;
+    b.ctx = ctx;
+    b.out = out;
+    b.window = (unsigned long) threads * BATCH_WINDOW_PER_THREAD;
+    b.slots = malloc(b.window * sizeof *b.slots);
+    b.head = 0;
+    b.tail = 0;
+    b.invalid = 0;
+    b.eof = 0;
+    if (!b.slots || !pool_init(&pool, threads)) {
+        free(b.slots);
+        return 0;
+    }
+    pthread_mutex_init(&b.lock, NULL);
+    pthread_cond_init(&b.space, NULL);
+    pthread_cond_init(&b.ready, NULL);
+    if (pthread_create(&writer, NULL, _batch_writer, &b) != 0) {
+        /* nothing has been read yet, so the caller can fall back to
+         * writing inline */
+        pool_destroy(&pool);
+        pthread_mutex_destroy(&b.lock);
+        pthread_cond_destroy(&b.space);
+        pthread_cond_destroy(&b.ready);
+        free(b.slots);
+        return 0;
+    }
+
+    while (1) {
+        pthread_mutex_lock(&b.lock);
+        while (b.tail - b.head == b.window) {
+            pthread_cond_wait(&b.space, &b.lock);
+        }
+        pthread_mutex_unlock(&b.lock);
+        /* only the reader touches the slot at tail until it is submitted */
+        struct batch_slot *slot = &b.slots[b.tail % b.window];
+        if (!_batch_next(mode, in, &slot->item)) {
+            break;
+        }
+        slot->batch = &b;
+        slot->done = 0;
+        (*count)++;
+        pthread_mutex_lock(&b.lock);
+        b.tail++;
+        pthread_mutex_unlock(&b.lock);
+        pool_submit(&pool, _batch_solve_slot, slot);
+    }
+
+    pthread_mutex_lock(&b.lock);
+    b.eof = 1;
+    pthread_cond_signal(&b.ready);
+    pthread_mutex_unlock(&b.lock);
+    pthread_join(writer, NULL);
+    pool_destroy(&pool);
+    pthread_mutex_destroy(&b.lock);
+    pthread_cond_destroy(&b.space);
+    pthread_cond_destroy(&b.ready);
+    *invalid += b.invalid;
+    free(b.slots);
+    return 1;
+}
+
+void _batch_run_serial(const struct batch_opts *bopts, enum batch_mode mode,
+                       struct pseudoku *ctx, struct batch_input *in,
+                       FILE *out, unsigned long *count,
+                       unsigned long *invalid) {
+    struct batch_item item;
+    char line[BATCH_LINE_MAX];
+    while (_batch_next(mode, in, &item)) {
+        int len = _batch_work(bopts, mode, ctx, &item, line);
+        fwrite(line, 1, len, out);
+        (*count)++;
+        *invalid += !item.box;
+    }
+}
+
+/* generate one puzzle at a time, with the work for each spread across the
+ * context's threads */
+void _batch_generate_split(struct pseudoku *ctx, struct batch_input *in,
+                           FILE *out, unsigned long *count) {
+    uint8_t cells[BOARD_CELLS];
+    char line[BATCH_LINE_MAX];
+    for (; in->remaining; in->remaining--) {
+        pseudoku_generate(ctx, in->seed++, cells);
+        pseudoku_format(3, cells, line);
+        line[BOARD_CELLS] = '\n';
+        fwrite(line, 1, BOARD_CELLS + 1, out);
+        (*count)++;
+    }
+}
+
+void batch_opts_init(struct batch_opts *opts) {
+    opts->threads = 1;
+    opts->show_stats = 0;
+    opts->engine = "logic";
+    opts->split = 0;
+    opts->graded = 0;
+    opts->grade_lo = 0;
+    opts->grade_hi = 0;
+}
+
+/* a context for each thread, set up as the options ask. returns NULL if
+ * the options are bad, or there is not the memory */
+struct pseudoku **_batch_contexts(const struct batch_opts *bopts, int n) {
+    struct pseudoku **ctx = calloc(n, sizeof *ctx);
+    for (int i = 0; ctx && i < n; i++) {
+        ctx[i] = pseudoku_new();
+        if (!ctx[i] || pseudoku_set_engine(ctx[i], bopts->engine) < 0) {
+            for (int j = 0; j <= i; j++) {
+                pseudoku_free(ctx[j]);
+            }
+            free(ctx);
+            return NULL;
+        }
+        pseudoku_set_stats(ctx[i], bopts->show_stats);
+    }
+    return ctx;
+}
+
+int _batch_drive(enum batch_mode mode, struct batch_input *in, FILE *out,
+                 const struct batch_opts *bopts) {
+    unsigned long count = 0;
+    unsigned long invalid = 0;
+    struct timespec start;
+    int threads = bopts->threads > 1 ? bopts->threads : 1;
+    int split = mode == BATCH_GENERATE && bopts->split && !bopts->graded;
+    struct pseudoku **ctx = _batch_contexts(bopts, split ? 1 : threads);
+    if (!ctx) {
+        return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (split) {
+        pseudoku_set_threads(ctx[0], threads);
+        _batch_generate_split(ctx[0], in, out, &count);
+        threads = 1;
+    } else if (threads == 1 ||
+               !_batch_run_parallel(bopts, mode, ctx, in, out, threads,
+                                    &count, &invalid)) {
+        _batch_run_serial(bopts, mode, ctx[0], in, out, &count, &invalid);
+    }
+    fflush(out);
+    double secs = _batch_elapsed(&start);
+    fprintf(stderr, "%lu puzzles (%lu invalid) in %.3f s, %.0f puzzles/s\n",
+            count, invalid, secs, secs > 0 ? count / secs : 0.0);
+    for (int i = 1; i < threads; i++) {
+        pseudoku_stats_add(ctx[0], ctx[i]);
+    }
+    if (bopts->show_stats) {
+        pseudoku_stats_print(ctx[0], stderr);
+    }
+    for (int i = 0; i < threads; i++) {
+        pseudoku_free(ctx[i]);
+    }
+    free(ctx);
+    return ferror(out) ? 1 : 0;
+}
+
+/* solve every puzzle in in, writing a result line for each to out in input
+ * order. the throughput goes to stderr, followed by the solver's counters
+ * if show_stats is set; they are not kept otherwise, since keeping them
+ * costs a little on every strategy run */
+int batch_run(enum batch_mode mode, FILE *in, FILE *out,
+              const struct batch_opts *opts) {
+    struct batch_input input = { in, NULL, 0, 0 };
+    return _batch_drive(mode, &input, out, opts);
+}
+
+/* as batch_run, for the records of a packed corpus. the reader only hands
+ * out views of the records, which are unpacked by the workers */
+int batch_run_packed(enum batch_mode mode,
+                     const struct pseudoku_corpus *corpus, FILE *out,
+                     const struct batch_opts *opts) {
+    struct batch_input input = { NULL, corpus, 0,
+                                 pseudoku_corpus_count(corpus) };
+    return _batch_drive(mode, &input, out, opts);
+}
+
+/* generate count puzzles from the seeds seed, seed + 1, ..., writing them to
+ * out in seed order */
+int batch_generate(FILE *out, unsigned long count, uint64_t seed,
+                   const struct batch_opts *opts) {
+    struct batch_input input = { NULL, NULL, seed, count };
+    return _batch_drive(BATCH_GENERATE, &input, out, opts);
+}
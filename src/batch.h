@@ -0,0 +1,38 @@
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "pseudoku.h"
+
+/* longest result line written for a single puzzle, including the newline
+ * and terminator; a 25x25 grid alone takes 625 characters */
+#define BATCH_LINE_MAX (PSEUDOKU_CELLS_MAX + 16)
+
+/* a 9x9 grid, the only size which can be generated or rated */
+#define BOARD_CELLS 81
+
+enum batch_mode { BATCH_SOLVE, BATCH_UNIQUE, BATCH_RATE, BATCH_GENERATE };
+
+struct batch_opts {
+    int threads; /* 1 solves on the calling thread */
+    int show_stats; /* collect solver counters, and print them at the end */
+    const char *engine; /* by name, as pseudoku_set_engine */
+    int split; /* generate one puzzle at a time, across all the threads;
+                * ungraded only, so the command rejects it with graded */
+    int graded; /* generate puzzles graded between grade_lo and grade_hi */
+    double grade_lo;
+    double grade_hi;
+};
+
+void batch_opts_init(struct batch_opts *opts);
+int batch_run(enum batch_mode mode, FILE *in, FILE *out,
+              const struct batch_opts *opts);
+int batch_run_packed(enum batch_mode mode,
+                     const struct pseudoku_corpus *corpus, FILE *out,
+                     const struct batch_opts *opts);
+int batch_generate(FILE *out, unsigned long count, uint64_t seed,
+                   const struct batch_opts *opts);
+
+#endif
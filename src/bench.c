@@ -0,0 +1,492 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "cell.h"
+#include "puzzle.h"
+#include "backtrack.h"
+#include "generator.h"
+#include "hidden.h"
+#include "stats.h"
+#include "strategy.h"
+#include "grid.h"
+#include "constants.h"
+
+/* sudoku-bench: runs the solver over the bundled corpora and reports
+ * throughput, per puzzle latency percentiles and search effort, as a table
+ * on stdout and optionally as json, so that runs can be diffed against a
+ * saved baseline. each corpus workload is run once per solver engine, so
+ * the engines can be compared head to head.
+ *
+ * the count workload counts solutions up to a limit; since every corpus
+ * puzzle is unique, it first blanks the last few givens of each puzzle,
+ * which leaves a sparse grid with (usually) many solutions */
+
+int _bench_sized(const char *tier) {
+    return strchr(tier, 'x') != NULL;
+}
+
+#ifndef CORPUS_DIR
+#define CORPUS_DIR "corpus"
+#endif
+
+/* the tiers named for a size hold grids of that size, which only the
+ * dancing links engine solves */
+const char *bench_tiers[] = {
+    "easy", "medium", "hard", "17clue", "4x4", "16x16", "25x25", NULL
+};
+
+enum bench_workload { BENCH_SOLVE, BENCH_UNIQUE, BENCH_COUNT, BENCH_GENERATE };
+const char *bench_workloads[] = {
+    "solve", "unique", "count", "generate", NULL
+};
+
+/* givens blanked from each puzzle by the count workload */
+#define BENCH_COUNT_BLANKED 4
+
+/* room for a result for every tier, workload and engine, with some over */
+#define BENCH_RESULTS_MAX 64
+
+struct bench_result {
+    const char *workload;
+    const char *engine;
+    const char *tier;
+    int puzzles;
+    double seconds;
+    double p50;
+    double p99;
+    double max;
+    struct stats stats;
+};
+
+double _bench_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+int _bench_cmp_double(const void *a, const void *b) {
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/* nearest rank percentile of a sorted array */
+double _bench_percentile(double *sorted, int n, double p) {
+    int i = (int) (p * n + 0.5) - 1;
+    if (i < 0) {
+        i = 0;
+    } else if (i >= n) {
+        i = n - 1;
+    }
+    return sorted[i];
+}
+
+FILE *_bench_open(const char *dir, const char *tier) {
+    char path[1024];
+    snprintf(path, sizeof path, "%s/%s.txt", dir, tier);
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+    }
+    return f;
+}
+
+/* read a corpus into a freshly allocated array of items of size bytes,
+ * each read with read, which returns as puzzle_read_line does */
+void *_bench_load_items(const char *dir, const char *tier, size_t size,
+                        int (*read)(void *item, FILE *f), int *count) {
+    FILE *f = _bench_open(dir, tier);
+    if (!f) {
+        return NULL;
+    }
+    int cap = 64;
+    int n = 0;
+    char *items = malloc(cap * size);
+    int res;
+    while (items && (res = read(items + n * size, f))) {
+        if (res == INCONSISTENT) {
+            continue;
+        }
+        if (++n == cap) {
+            char *more = realloc(items, 2 * cap * size);
+            if (!more) {
+                free(items);
+                items = NULL;
+                break;
+            }
+            items = more;
+            cap *= 2;
+        }
+    }
+    fclose(f);
+    if (!items) {
+        fprintf(stderr, "%s: out of memory\n", tier);
+    }
+    *count = n;
+    return items;
+}
+
+int _bench_read_grid(void *item, FILE *f) {
+    return grid_read_line(item, f);
+}
+
+int _bench_read_puzzle(void *item, FILE *f) {
+    return puzzle_read_line(item, f);
+}
+
+void _bench_summarize(struct bench_result *r, double *latencies, int n) {
+    qsort(latencies, n, sizeof *latencies, _bench_cmp_double);
+    r->puzzles = n;
+    r->p50 = n ? _bench_percentile(latencies, n, 0.50) : 0;
+    r->p99 = n ? _bench_percentile(latencies, n, 0.99) : 0;
+    r->max = n ? latencies[n - 1] : 0;
+}
+
+/* blank the last few givens of a puzzle, in row major order */
+void _bench_blank(puzzle puz) {
+    int blanked = 0;
+    for (int cell = BOARD_LENGTH - 1;
+         cell >= 0 && blanked < BENCH_COUNT_BLANKED; cell--) {
+        if (puz[cell % 9][cell / 9].complete) {
+            puzzle_clear_cell(puz, cell % 9, cell / 9);
+            blanked++;
+        }
+    }
+}
+
+/* the runs below return 0, with a message, if they run out of memory */
+int _bench_corpus(struct bench_result *r, enum bench_workload w,
+                  enum search_engine engine, puzzle *puzzles, int n,
+                  int reps, int count_max) {
+    double *latencies = malloc(n * reps * sizeof *latencies);
+    int max = w == BENCH_SOLVE ? 1 : w == BENCH_UNIQUE ? 2 : count_max;
+    struct workspace *ws = workspace_new();
+    int ok = latencies && ws;
+    struct search_opts opts;
+    search_opts_init(&opts);
+    opts.engine = engine;
+    opts.stats = &r->stats;
+    opts.space = ws;
+    stats_reset(&r->stats);
+    double start = _bench_now();
+    for (int rep = 0; ok && rep < reps; rep++) {
+        for (int i = 0; ok && i < n; i++) {
+            puzzle puz;
+            puzzle_copy(puzzles[i], puz);
+            if (w == BENCH_COUNT) {
+                _bench_blank(puz);
+            }
+            double t = _bench_now();
+            puzzle_pencil_possibilities(puz);
+            ok = puzzle_search(puz, max, &opts) != SEARCH_NO_MEMORY;
+            latencies[rep * n + i] = _bench_now() - t;
+        }
+    }
+    r->seconds = _bench_now() - start;
+    if (ok) {
+        _bench_summarize(r, latencies, n * reps);
+    } else {
+        fprintf(stderr, "out of memory\n");
+    }
+    free(latencies);
+    workspace_free(ws);
+    return ok;
+}
+
+/* as _bench_corpus, for grids of other sizes, on the dancing links engine */
+int _bench_grids(struct bench_result *r, enum bench_workload w,
+                 struct grid *grids, int n, int reps, int count_max) {
+    double *latencies = malloc(n * reps * sizeof *latencies);
+    int max = w == BENCH_SOLVE ? 1 : w == BENCH_UNIQUE ? 2 : count_max;
+    int ok = latencies != NULL;
+    struct dlx_arenas arenas;
+    memset(&arenas, 0, sizeof arenas);
+    stats_reset(&r->stats);
+    double start = _bench_now();
+    for (int rep = 0; ok && rep < reps; rep++) {
+        for (int i = 0; ok && i < n; i++) {
+            struct grid g = grids[i];
+            int cells = g.side * g.side;
+            for (int c = cells - 1, blanked = 0;
+                 w == BENCH_COUNT && c >= 0 && blanked < BENCH_COUNT_BLANKED;
+                 c--) {
+                if (g.cells[c]) {
+                    g.cells[c] = 0;
+                    blanked++;
+                }
+            }
+            double t = _bench_now();
+            ok = grid_search(&g, max, &r->stats, &arenas) >= 0;
+            latencies[rep * n + i] = _bench_now() - t;
+        }
+    }
+    r->seconds = _bench_now() - start;
+    if (ok) {
+        _bench_summarize(r, latencies, n * reps);
+    } else {
+        fprintf(stderr, "out of memory\n");
+    }
+    free(latencies);
+    dlx_arenas_free(&arenas);
+    return ok;
+}
+
+int _bench_generate(struct bench_result *r, int n) {
+    double *latencies = malloc(n * sizeof *latencies);
+    struct workspace *ws = workspace_new();
+    if (!latencies || !ws) {
+        fprintf(stderr, "out of memory\n");
+        free(latencies);
+        workspace_free(ws);
+        return 0;
+    }
+    stats_reset(&r->stats);
+    double start = _bench_now();
+    for (int i = 0; i < n; i++) {
+        puzzle puz;
+        double t = _bench_now();
+        puzzle_generate_seeded(puz, i, ws, &r->stats);
+        latencies[i] = _bench_now() - t;
+    }
+    r->seconds = _bench_now() - start;
+    _bench_summarize(r, latencies, n);
+    free(latencies);
+    workspace_free(ws);
+    return 1;
+}
+
+/* the time per search node, which shows the cost of the work at each node
+ * apart from changes in how many nodes a search takes */
+double _bench_ns_per_node(struct bench_result *r) {
+    return r->stats.nodes ? r->seconds * 1e9 / r->stats.nodes : 0.0;
+}
+
+void _bench_print(struct bench_result *r, FILE *f) {
+    double n = r->puzzles ? r->puzzles : 1;
+    fprintf(f, "%-9s %-6s %-7s %7d %11.0f %9.1f %9.1f %10.1f %8.2f %8.2f "
+            "%8.0f\n", r->workload, r->engine, r->tier, r->puzzles,
+            r->seconds > 0 ? r->puzzles / r->seconds : 0.0,
+            r->p50 * 1e6, r->p99 * 1e6, r->max * 1e6,
+            r->stats.nodes / n, r->stats.guesses / n, _bench_ns_per_node(r));
+}
+
+void _bench_json(struct bench_result *results, int count, FILE *f) {
+    fprintf(f, "{\n  \"kernel\": \"%s\",\n  \"results\": [\n",
+            hidden_kernel_names[hidden_kernel]);
+    for (int i = 0; i < count; i++) {
+        struct bench_result *r = &results[i];
+        double n = r->puzzles ? r->puzzles : 1;
+        fprintf(f, "    {\"workload\": \"%s\", \"engine\": \"%s\", "
+                "\"tier\": \"%s\", \"puzzles\": %d, \"seconds\": %.6f, "
+                "\"puzzles_per_sec\": %.1f, "
+                "\"p50_us\": %.2f, \"p99_us\": %.2f, \"max_us\": %.2f, "
+                "\"nodes_per_puzzle\": %.3f, \"guesses_per_puzzle\": %.3f, "
+                "\"backtracks_per_puzzle\": %.3f, \"ns_per_node\": %.1f, "
+                "\"max_depth\": %llu, "
+                "\"strategies\": [",
+                r->workload, r->engine, r->tier, r->puzzles, r->seconds,
+                r->seconds > 0 ? r->puzzles / r->seconds : 0.0,
+                r->p50 * 1e6, r->p99 * 1e6, r->max * 1e6,
+                r->stats.nodes / n, r->stats.guesses / n,
+                r->stats.backtracks / n, _bench_ns_per_node(r),
+                (unsigned long long) r->stats.max_depth);
+        for (int j = 0; j < strategy_count(); j++) {
+            const struct strategy_stats *ss = &r->stats.strategy[j];
+            fprintf(f, "%s{\"name\": \"%s\", \"calls\": %llu, "
+                    "\"productive\": %llu, \"eliminated\": %llu, "
+                    "\"filled\": %llu, \"cycles\": %llu}",
+                    j ? ", " : "", strategy_name(j),
+                    (unsigned long long) ss->invocations,
+                    (unsigned long long) ss->productive,
+                    (unsigned long long) ss->eliminated,
+                    (unsigned long long) ss->filled,
+                    (unsigned long long) ss->cycles);
+        }
+        fprintf(f, "]}%s\n", i + 1 < count ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+}
+
+/* the next result, filled in with its names, or NULL if there is no room
+ * for another */
+struct bench_result *_bench_result(struct bench_result *results, int *count,
+                                   const char *workload, const char *engine,
+                                   const char *tier) {
+    if (*count == BENCH_RESULTS_MAX) {
+        fprintf(stderr, "too many results\n");
+        return NULL;
+    }
+    struct bench_result *r = &results[(*count)++];
+    r->workload = workload;
+    r->engine = engine;
+    r->tier = tier;
+    return r;
+}
+
+int _bench_index(const char **names, const char *name) {
+    for (int i = 0; names[i]; i++) {
+        if (strcmp(names[i], name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void _bench_usage(void) {
+    puts("Usage: ./sudoku-bench [--corpus DIR] [--tier T]... "
+         "[--workload W]...\n"
+         "                      [--engine E]... [--reps N] [--count N]\n"
+         "                      [--generate N] [--kernel K] [--enable S]\n"
+         "                      [--json FILE]\n"
+         "tiers: easy medium hard 17clue 4x4 16x16 25x25 (default: all)\n"
+         "workloads: solve unique count generate (default: all)\n"
+         "engines: logic dlx (default: all)");
+}
+
+int main(int argc, char *argv[]) {
+    const char *dir = CORPUS_DIR;
+    const char *json = NULL;
+    int tiers = 0;
+    int workloads = 0;
+    int engines = 0;
+    int reps = 1;
+    int count_max = 1000;
+    int generate = 20;
+    /* every option takes a value */
+    for (int i = 1; i < argc; i += 2) {
+        if (i + 1 >= argc) {
+            _bench_usage();
+            return 1;
+        }
+        const char *opt = argv[i];
+        const char *val = argv[i + 1];
+        int k = -1;
+        if (strcmp(opt, "--corpus") == 0) {
+            dir = val;
+        } else if (strcmp(opt, "--tier") == 0 &&
+                   (k = _bench_index(bench_tiers, val)) >= 0) {
+            tiers |= 1 << k;
+        } else if (strcmp(opt, "--workload") == 0 &&
+                   (k = _bench_index(bench_workloads, val)) >= 0) {
+            workloads |= 1 << k;
+        } else if (strcmp(opt, "--engine") == 0 &&
+                   (k = search_engine_by_name(val)) >= 0) {
+            engines |= 1 << k;
+        } else if (strcmp(opt, "--count") == 0) {
+            count_max = atoi(val);
+        } else if (strcmp(opt, "--reps") == 0) {
+            reps = atoi(val);
+        } else if (strcmp(opt, "--generate") == 0) {
+            generate = atoi(val);
+        } else if (strcmp(opt, "--kernel") == 0 &&
+                   (k = hidden_kernel_by_name(val)) >= 0) {
+            hidden_select(k);
+        } else if (strcmp(opt, "--enable") == 0 &&
+                   (k = strategy_by_name(val)) >= 0) {
+            strategy_enable(k, 1);
+        } else if (strcmp(opt, "--json") == 0) {
+            json = val;
+        } else {
+            _bench_usage();
+            return 1;
+        }
+    }
+    if (!tiers) {
+        tiers = ~0;
+    }
+    if (!workloads) {
+        workloads = ~0;
+    }
+    if (!engines) {
+        engines = ~0;
+    }
+    if (reps < 1) {
+        reps = 1;
+    }
+
+    struct bench_result results[BENCH_RESULTS_MAX];
+    struct bench_result *r;
+    int count = 0;
+    printf("%-9s %-6s %-7s %7s %11s %9s %9s %10s %8s %8s %8s\n", "workload",
+           "engine", "tier", "puzzles", "puzzles/s", "p50(us)", "p99(us)",
+           "max(us)", "nodes", "guesses", "ns/node");
+    for (int t = 0; bench_tiers[t]; t++) {
+        if (!(tiers & (1 << t))) {
+            continue;
+        }
+        int n;
+        if (_bench_sized(bench_tiers[t])) {
+            if (!(engines & (1 << ENGINE_DLX))) {
+                continue;
+            }
+            struct grid *grids = _bench_load_items(dir, bench_tiers[t],
+                                                   sizeof *grids,
+                                                   _bench_read_grid, &n);
+            if (!grids) {
+                return 1;
+            }
+            for (int w = BENCH_SOLVE; w <= BENCH_COUNT; w++) {
+                if (!(workloads & (1 << w))) {
+                    continue;
+                }
+                r = _bench_result(results, &count, bench_workloads[w],
+                                  search_engine_names[ENGINE_DLX],
+                                  bench_tiers[t]);
+                if (!r || !_bench_grids(r, w, grids, n, reps, count_max)) {
+                    free(grids);
+                    return 1;
+                }
+                _bench_print(r, stdout);
+            }
+            free(grids);
+            continue;
+        }
+        puzzle *puzzles = _bench_load_items(dir, bench_tiers[t],
+                                            sizeof *puzzles,
+                                            _bench_read_puzzle, &n);
+        if (!puzzles) {
+            return 1;
+        }
+        for (int w = BENCH_SOLVE; w <= BENCH_COUNT; w++) {
+            for (int e = 0; search_engine_names[e]; e++) {
+                if (!(workloads & (1 << w)) || !(engines & (1 << e))) {
+                    continue;
+                }
+                r = _bench_result(results, &count, bench_workloads[w],
+                                  search_engine_names[e], bench_tiers[t]);
+                if (!r ||
+                    !_bench_corpus(r, w, e, puzzles, n, reps, count_max)) {
+                    free(puzzles);
+                    return 1;
+                }
+                _bench_print(r, stdout);
+            }
+        }
+        free(puzzles);
+    }
+    if (workloads & (1 << BENCH_GENERATE) && generate > 0) {
+        r = _bench_result(results, &count, bench_workloads[BENCH_GENERATE],
+                          "-", "-");
+        if (!r || !_bench_generate(r, generate)) {
+            return 1;
+        }
+        _bench_print(r, stdout);
+    }
+
+    if (json) {
+        FILE *f = strcmp(json, "-") == 0 ? stdout : fopen(json, "w");
+        if (!f) {
+            perror(json);
+            return 1;
+        }
+        _bench_json(results, count, f);
+        if (f != stdout) {
+            fclose(f);
+        }
+    }
+    return 0;
+}
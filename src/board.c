@@ -0,0 +1,214 @@
+#include <assert.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "board.h"
+#include "puzzle.h"
+#include "constants.h"
+#include "hidden.h"
+
+static pthread_once_t _kernel_once = PTHREAD_ONCE_INIT;
+
+/* settle on a hidden single kernel before the first board is solved */
+void _board_kernel_init(void) {
+    if (hidden_kernel == HIDDEN_AUTO) {
+        hidden_select(HIDDEN_AUTO);
+    }
+}
+
+void _board_set_lanes(struct board *b, int cell, uint16_t mask) {
+    uint16_t *lanes = &b->lanes[0][0];
+    lanes[cell_lanes[cell][0]] = mask;
+    lanes[cell_lanes[cell][1]] = mask;
+    lanes[cell_lanes[cell][2]] = mask;
+}
+
+/* load a puzzle, taking the pencil marks of incomplete cells as given.
+ * everything starts out dirty, so the first board_logic looks at it all */
+void board_load(struct board *b, puzzle puz) {
+    pthread_once(&_kernel_once, _board_kernel_init);
+    puzzle_copy(puz, b->grid);
+    memset(b->placed, 0, sizeof b->placed);
+    memset(b->cand, 0, sizeof b->cand);
+    memset(b->by_count, 0, sizeof b->by_count);
+    /* the padding lanes must look like complete units */
+    for (int p = 0; p < GROUP_LENGTH; p++) {
+        for (int u = UNIT_COUNT; u < LANE_UNITS; u++) {
+            b->lanes[p][u] = ink_to_pencil(p + 1);
+        }
+    }
+    for (int d = 0; d < 9; d++) {
+        b->dirty.units[d] = ALL_UNITS;
+    }
+    memset(&b->dirty.cells, 0, sizeof b->dirty.cells);
+    b->unfilled = 0;
+    b->stats = NULL;
+    b->trail = NULL;
+    for (int i = 0; i < BOARD_LENGTH; i++) {
+        struct cell *c = &b->grid[CELL_X(i)][CELL_Y(i)];
+        if (c->complete) {
+            uint16_t bit = ink_to_pencil(c->u.ink);
+            for (int t = 0; t < 3; t++) {
+                (&b->placed[0][0])[cell_units[i][t]] |= bit;
+            }
+        } else {
+            uint16_t pencil = c->u.pencil;
+            while (pencil) {
+                bb_set(&b->cand[__builtin_ctz(pencil)], i);
+                pencil &= pencil - 1;
+            }
+            bb_set(&b->dirty.cells, i);
+            bb_set(&b->by_count[hamming_weight(c->u.pencil)], i);
+            b->unfilled++;
+        }
+        _board_set_lanes(b, i, cell_coerce_pencil(c));
+    }
+}
+
+/* remove the digits in mask from a cell's pencil marks */
+int board_eliminate(struct board *b, int cell, uint16_t mask) {
+    struct cell *c = &b->grid[CELL_X(cell)][CELL_Y(cell)];
+    if (c->complete) {
+        return NO_CHANGE;
+    }
+    uint16_t gone = c->u.pencil & mask;
+    if (!gone) {
+        return NO_CHANGE;
+    }
+    if (b->trail) {
+        struct trail_entry *e = &b->trail->entries[b->trail->len++];
+        assert(b->trail->len <= TRAIL_MAX);
+        e->cell = cell;
+        e->fill = 0;
+        e->bits = gone;
+    }
+    if (b->stats) {
+        b->stats->eliminated += hamming_weight(gone);
+    }
+    bb_clear(&b->by_count[hamming_weight(c->u.pencil)], cell);
+    c->u.pencil &= ~mask;
+    bb_set(&b->by_count[hamming_weight(c->u.pencil)], cell);
+    _board_set_lanes(b, cell, c->u.pencil);
+    bb_set(&b->dirty.cells, cell);
+    while (gone) {
+        int d = __builtin_ctz(gone);
+        bb_clear(&b->cand[d], cell);
+        b->dirty.units[d] |= cell_unit_bits[cell];
+        gone &= gone - 1;
+    }
+    return c->u.pencil ? CHANGE : INCONSISTENT;
+}
+
+/* remove digit n from the pencil marks of each of the given cells */
+int board_eliminate_digit(struct board *b, int n, struct bitboard cells) {
+    uint16_t bit = ink_to_pencil(n);
+    int change = NO_CHANGE;
+    cells = bb_and(cells, b->cand[n - 1]);
+    while (!bb_empty(cells)) {
+        if (board_eliminate(b, bb_pop(&cells), bit) == INCONSISTENT) {
+            return INCONSISTENT;
+        }
+        change = CHANGE;
+    }
+    return change;
+}
+
+/* ink n into an incomplete cell, and pencil it out of all the cell's peers.
+ * unlike puzzle_fill_cell, this reports when the fill leaves the board
+ * inconsistent: n already placed in one of the cell's units, or a peer
+ * left without any possibilities */
+int board_fill_cell(struct board *b, int cell, int n) {
+    struct cell *c = &b->grid[CELL_X(cell)][CELL_Y(cell)];
+    assert(!c->complete);
+    uint16_t bit = ink_to_pencil(n);
+    uint16_t pencil = c->u.pencil | bit;
+    while (pencil) {
+        int d = __builtin_ctz(pencil);
+        bb_clear(&b->cand[d], cell);
+        b->dirty.units[d] |= cell_unit_bits[cell];
+        pencil &= pencil - 1;
+    }
+    int res = CHANGE;
+    uint8_t fresh = 0;
+    for (int t = 0; t < 3; t++) {
+        uint16_t *placed = &b->placed[0][0] + cell_units[cell][t];
+        if (*placed & bit) {
+            res = INCONSISTENT;
+        } else {
+            fresh |= 1 << t;
+        }
+        *placed |= bit;
+    }
+    if (b->trail) {
+        struct trail_entry *e = &b->trail->entries[b->trail->len++];
+        assert(b->trail->len <= TRAIL_MAX);
+        e->cell = cell;
+        e->fill = TRAIL_FILL | fresh;
+        e->bits = c->u.pencil;
+    }
+    if (b->stats) {
+        b->stats->filled++;
+    }
+    bb_clear(&b->by_count[hamming_weight(c->u.pencil)], cell);
+    c->complete = 1;
+    c->u.ink = n;
+    b->unfilled--;
+    _board_set_lanes(b, cell, bit);
+    if (board_eliminate_digit(b, n, peer_bb[cell]) == INCONSISTENT) {
+        res = INCONSISTENT;
+    }
+    return res;
+}
+
+/* roll the board back to how it was when the trail was mark entries long.
+ * marks are only taken once board_logic has finished with the board, so
+ * there is never any work outstanding at a mark */
+void board_undo(struct board *b, int mark) {
+    struct trail *trail = b->trail;
+    while (trail->len > mark) {
+        struct trail_entry *e = &trail->entries[--trail->len];
+        struct cell *c = &b->grid[CELL_X(e->cell)][CELL_Y(e->cell)];
+        if (e->fill) {
+            uint16_t bit = ink_to_pencil(c->u.ink);
+            for (int t = 0; t < 3; t++) {
+                if (e->fill & (1 << t)) {
+                    (&b->placed[0][0])[cell_units[e->cell][t]] &= ~bit;
+                }
+            }
+            c->complete = 0;
+            c->u.pencil = e->bits;
+            b->unfilled++;
+        } else {
+            bb_clear(&b->by_count[hamming_weight(c->u.pencil)], e->cell);
+            c->u.pencil |= e->bits;
+        }
+        bb_set(&b->by_count[hamming_weight(c->u.pencil)], e->cell);
+        _board_set_lanes(b, e->cell, c->u.pencil);
+        uint16_t bits = e->bits;
+        while (bits) {
+            bb_set(&b->cand[__builtin_ctz(bits)], e->cell);
+            bits &= bits - 1;
+        }
+    }
+    memset(&b->dirty, 0, sizeof b->dirty);
+}
+
+int dirty_empty(const struct dirty *d) {
+    return !dirty_units(d) && bb_empty(d->cells);
+}
+
+void dirty_merge(struct dirty *dst, const struct dirty *src) {
+    for (int d = 0; d < 9; d++) {
+        dst->units[d] |= src->units[d];
+    }
+    dst->cells = bb_or(dst->cells, src->cells);
+}
+
+/* the units with any dirty digit */
+uint32_t dirty_units(const struct dirty *d) {
+    uint32_t units = 0;
+    for (int i = 0; i < 9; i++) {
+        units |= d->units[i];
+    }
+    return units;
+}
@@ -0,0 +1,127 @@
+#ifndef __BOARD_H__
+#define __BOARD_H__
+
+#include <stdint.h>
+
+#include "cell.h"
+#include "constants.h"
+#include "stats.h"
+#include "units.h"
+
+/* work left for the strategies: for each digit, the units where its
+ * candidates have changed, and the cells whose candidates have changed,
+ * since the strategies last looked at them */
+struct dirty {
+    uint32_t units[9]; /* bit u of units[d] is unit u, for digit d + 1 */
+    struct bitboard cells;
+};
+
+/* a journal of the changes made to a board, so that a search can undo
+ * back to an earlier point instead of keeping copies of the board.
+ * eliminations record the pencil bits removed; fills record the cell's
+ * pencil marks before the fill, and which of the cell's units did not
+ * already have the digit placed. along one search path a cell can lose
+ * each of its nine possibilities at most once and be filled at most once,
+ * which bounds the length of the journal */
+#define TRAIL_MAX (BOARD_LENGTH * (GROUP_LENGTH + 1))
+#define TRAIL_FILL 0x80
+
+struct trail_entry {
+    uint8_t cell;
+    uint8_t fill; /* TRAIL_FILL | units newly placed, or 0 for eliminations */
+    uint16_t bits;
+};
+
+struct trail {
+    int len;
+    struct trail_entry entries[TRAIL_MAX];
+};
+
+/* the solver's view of a puzzle. alongside the usual grid of cells, it keeps
+ * summaries which would otherwise have to be rebuilt by walking every unit:
+ *
+ * placed[t][i]: the digits inked in unit i of type t (ROW, COL or BOX),
+ *               so those of unit u are at &placed[0][0] + u
+ * cand[d]:      the incomplete cells which still have digit d + 1 pencilled
+ * by_count[k]:  the incomplete cells with exactly k digits pencilled, so the
+ *               most constrained cells can be found without a scan
+ * lanes[p][u]:  the pencil marks of the p-th cell of unit u (or the bit for
+ *               its ink, if complete), laid out so that vector code can
+ *               load the same position of many units at once
+ *
+ * all changes to a board must go through board_fill_cell and
+ * board_eliminate, which keep the summaries in step with the grid, and
+ * record what they touched in dirty so that board_logic only revisits the
+ * parts of the board which have changed.
+ *
+ * stats, if not NULL, is where the solver counts its work, and trail, if
+ * not NULL, is where changes are journalled for board_undo */
+struct board {
+    puzzle grid;
+    uint16_t placed[3][9];
+    struct bitboard cand[9];
+    struct bitboard by_count[GROUP_LENGTH + 1];
+    uint16_t lanes[GROUP_LENGTH][LANE_UNITS];
+    int unfilled;
+    struct dirty dirty;
+    struct stats *stats;
+    struct trail *trail;
+};
+
+void board_load(struct board *b, puzzle puz);
+int board_fill_cell(struct board *b, int cell, int n);
+int board_eliminate(struct board *b, int cell, uint16_t mask);
+int board_eliminate_digit(struct board *b, int n, struct bitboard cells);
+void board_undo(struct board *b, int mark);
+int dirty_empty(const struct dirty *d);
+void dirty_merge(struct dirty *dst, const struct dirty *src);
+uint32_t dirty_units(const struct dirty *d);
+
+static inline struct bitboard bb_and(struct bitboard a, struct bitboard b) {
+    struct bitboard r = {{ a.w[0] & b.w[0], a.w[1] & b.w[1] }};
+    return r;
+}
+
+static inline struct bitboard bb_andnot(struct bitboard a, struct bitboard b) {
+    struct bitboard r = {{ a.w[0] & ~b.w[0], a.w[1] & ~b.w[1] }};
+    return r;
+}
+
+static inline struct bitboard bb_or(struct bitboard a, struct bitboard b) {
+    struct bitboard r = {{ a.w[0] | b.w[0], a.w[1] | b.w[1] }};
+    return r;
+}
+
+static inline int bb_empty(struct bitboard a) {
+    return !(a.w[0] | a.w[1]);
+}
+
+static inline int bb_count(struct bitboard a) {
+    return __builtin_popcountll(a.w[0]) + __builtin_popcountll(a.w[1]);
+}
+
+static inline void bb_set(struct bitboard *a, int i) {
+    a->w[i >> 6] |= 1ULL << (i & 63);
+}
+
+static inline void bb_clear(struct bitboard *a, int i) {
+    a->w[i >> 6] &= ~(1ULL << (i & 63));
+}
+
+static inline int bb_test(struct bitboard a, int i) {
+    return (a.w[i >> 6] >> (i & 63)) & 1;
+}
+
+/* index of the lowest cell in a non-empty set */
+static inline int bb_first(struct bitboard a) {
+    return a.w[0] ? __builtin_ctzll(a.w[0]) : 64 + __builtin_ctzll(a.w[1]);
+}
+
+/* remove and return the lowest cell in a non-empty set */
+static inline int bb_pop(struct bitboard *a) {
+    int i = bb_first(*a);
+    bb_clear(a, i);
+    return i;
+}
+
+#endif
@@ -0,0 +1,516 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "count.h"
+#include "grid.h"
+#include "puzzle.h"
+
+struct count_job;
+
+/* what each worker keeps to itself: its options and sink, which point at
+ * its own workspace and counters, and its share of the count */
+struct count_worker {
+    struct count_job *job;
+    int index;
+    struct search_opts opts;
+    struct solutions sink;
+    struct stats stats;
+    uint64_t count;
+    unsigned polls;
+};
+
+struct count_task {
+    struct count_job *job;
+    uint8_t cells[GRID_CELLS_MAX];
+};
+
+/* pending is the stack of subproblems still to do, on the calling thread,
+ * or, with a pool, those set aside by a checkpoint. draining is raised
+ * for a checkpoint, and stopping as well if the job is to stop there.
+ * failed is raised when a subproblem or a search is lost for want of
+ * memory, which spoils the count */
+struct count_job {
+    int box;
+    int side;
+    const struct count_opts *opts;
+    int nworkers;
+    struct count_worker *workers;
+    int fn_stopped;
+    int failed;
+    int draining;
+    int stopping;
+    double due;
+    pthread_mutex_t lock;
+    struct count_task **pending;
+    int npending;
+    int cap;
+};
+
+void count_opts_init(struct count_opts *opts) {
+    memset(opts, 0, sizeof *opts);
+}
+
+double _count_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/* a subproblem, or NULL if out of memory */
+struct count_task *_count_task_new(struct count_job *job,
+                                   const uint8_t *cells) {
+    struct count_task *t = malloc(sizeof *t);
+    if (!t) {
+        return NULL;
+    }
+    t->job = job;
+    memcpy(t->cells, cells, job->side * job->side);
+    return t;
+}
+
+/* push a subproblem onto the stack. a task which could not be made, or
+ * which there is no room for, fails the job */
+void _count_set_aside(struct count_job *job, struct count_task *t) {
+    pthread_mutex_lock(&job->lock);
+    if (t && job->npending == job->cap) {
+        int cap = job->cap ? job->cap * 2 : 64;
+        struct count_task **pending = realloc(job->pending,
+                                              cap * sizeof *pending);
+        if (pending) {
+            job->pending = pending;
+            job->cap = cap;
+        } else {
+            free(t);
+            t = NULL;
+        }
+    }
+    if (t) {
+        job->pending[job->npending++] = t;
+    } else {
+        __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&job->lock);
+}
+
+/* whether a checkpoint is under way, after starting one if it is due. a
+ * cancel, when there are checkpoints, is turned into a last one */
+int _count_draining(struct count_job *job) {
+    const struct count_opts *opts = job->opts;
+    if (!opts->checkpoint ||
+        __atomic_load_n(&job->draining, __ATOMIC_RELAXED)) {
+        return __atomic_load_n(&job->draining, __ATOMIC_RELAXED);
+    }
+    if (opts->cancel && __atomic_load_n(opts->cancel, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&job->stopping, 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&job->draining, 1, __ATOMIC_RELAXED);
+    } else if (opts->every > 0 && _count_now() >= job->due) {
+        __atomic_store_n(&job->draining, 1, __ATOMIC_RELAXED);
+    }
+    return __atomic_load_n(&job->draining, __ATOMIC_RELAXED);
+}
+
+/* count one subproblem to the end, or until it gives its work away. a
+ * search which runs out of memory fails the job */
+uint64_t _count_grid(struct count_worker *w, uint8_t *cells, uint64_t max) {
+    struct count_job *job = w->job;
+    uint64_t count;
+    if (solutions_cancelled(&w->sink)) {
+        return 0;
+    }
+    if (job->box != 3) {
+        count = dlx_search_sized(job->box, cells, max, w->opts.stats,
+                                 &w->opts.space->arenas, &w->sink);
+    } else {
+        struct grid g;
+        puzzle puz;
+        g.box = 3;
+        g.side = GROUP_LENGTH;
+        memcpy(g.cells, cells, BOARD_LENGTH);
+        grid_to_puzzle(&g, puz);
+        puzzle_pencil_possibilities(puz);
+        if (!puzzle_is_consistent(puz)) {
+            return 0;
+        }
+        count = puzzle_enumerate(puz, max, &w->opts);
+    }
+    if (count == ENUMERATE_NO_MEMORY) {
+        __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+    return count;
+}
+
+void _count_task(void *arg, int worker) {
+    struct count_task *t = arg;
+    struct count_job *job = t->job;
+    struct count_worker *w = &job->workers[worker];
+    if (__atomic_load_n(&job->failed, __ATOMIC_RELAXED)) {
+        free(t);
+        return;
+    }
+    if (_count_draining(job)) {
+        _count_set_aside(job, t);
+        return;
+    }
+    w->count += _count_grid(w, t->cells, UINT64_MAX);
+    free(t);
+}
+
+/* the clock is only looked at every COUNT_POLL_CLOCK polls; in between, a
+ * poll is a count and a load or two. with checkpoints, the cancel flag is
+ * looked at on every poll, as the search would without them, so that a
+ * cancel drains the job at once */
+int _count_wanted(void *arg) {
+    struct count_worker *w = arg;
+    struct count_job *job = w->job;
+    const int *cancel = job->opts->checkpoint ? job->opts->cancel : NULL;
+    int draining = ++w->polls % COUNT_POLL_CLOCK == 0 ||
+                   (cancel && __atomic_load_n(cancel, __ATOMIC_RELAXED)) ?
+                   _count_draining(job) :
+                   __atomic_load_n(&job->draining, __ATOMIC_RELAXED);
+    if (draining) {
+        return SPLIT_ALL;
+    }
+    if (job->opts->pool && pool_starved(job->opts->pool)) {
+        return SPLIT_ONE;
+    }
+    return SPLIT_NONE;
+}
+
+void _count_give(const uint8_t *cells, void *arg) {
+    struct count_worker *w = arg;
+    struct count_job *job = w->job;
+    struct count_task *t = _count_task_new(job, cells);
+    if (t && job->opts->pool &&
+        !__atomic_load_n(&job->draining, __ATOMIC_RELAXED)) {
+        pool_submit_local(job->opts->pool, w->index, _count_task, t);
+    } else {
+        _count_set_aside(job, t);
+    }
+}
+
+int _count_solution(const uint8_t *cells, void *arg) {
+    struct count_worker *w = arg;
+    struct count_job *job = w->job;
+    job->fn_stopped = job->opts->fn(cells, job->opts->arg) != 0;
+    return job->fn_stopped;
+}
+
+/* the state of the job (see count.h), or NULL if out of memory */
+char *_count_state(struct count_job *job, uint64_t found) {
+    struct grid g;
+    size_t size = 128 + (size_t) job->npending * (job->side * job->side + 1);
+    char *state = malloc(size);
+    if (!state) {
+        return NULL;
+    }
+    int len = sprintf(state, "%s\nbox %d\nfound %llu\ngrids %d\n",
+                      COUNT_STATE_MAGIC, job->box,
+                      (unsigned long long) found, job->npending);
+    g.box = job->box;
+    g.side = job->side;
+    for (int i = 0; i < job->npending; i++) {
+        memcpy(g.cells, job->pending[i]->cells, job->side * job->side);
+        grid_to_line(&g, state + len);
+        len += job->side * job->side;
+        state[len++] = '\n';
+    }
+    state[len] = '\0';
+    return state;
+}
+
+/* hand the state to the checkpoint callback, and set the job going again
+ * unless it is to stop. returns 0 if it is. a failed job has lost work,
+ * so its state is not handed out */
+int _count_checkpoint(struct count_job *job, uint64_t found) {
+    const struct count_opts *opts = job->opts;
+    int stop = job->stopping;
+    char *state = job->failed ? NULL : _count_state(job, found);
+    if (state) {
+        stop = opts->checkpoint(state, opts->checkpoint_arg) || stop;
+        free(state);
+    }
+    job->due = _count_now() + opts->every;
+    __atomic_store_n(&job->draining, 0, __ATOMIC_RELAXED);
+    return !stop;
+}
+
+/* work through the stack of subproblems on the calling thread */
+int _count_serial(struct count_job *job, uint64_t *found) {
+    const struct count_opts *opts = job->opts;
+    struct count_worker *w = &job->workers[0];
+    while (job->npending) {
+        if (job->failed) {
+            return COUNT_NO_MEMORY;
+        }
+        if (job->fn_stopped || (opts->limit && *found >= opts->limit) ||
+            solutions_cancelled(&w->sink)) {
+            return COUNT_STOPPED;
+        }
+        struct count_task *t = job->pending[--job->npending];
+        uint64_t max = opts->limit ? opts->limit - *found : UINT64_MAX;
+        *found += _count_grid(w, t->cells, max);
+        free(t);
+        if (job->draining && !_count_checkpoint(job, *found)) {
+            return COUNT_STOPPED;
+        }
+    }
+    if (job->failed) {
+        return COUNT_NO_MEMORY;
+    }
+    if (job->fn_stopped || (opts->limit && *found >= opts->limit) ||
+        solutions_cancelled(&w->sink)) {
+        return COUNT_STOPPED;
+    }
+    return COUNT_DONE;
+}
+
+/* deal the subproblems out over the pool, and when a checkpoint drains
+ * it, take the checkpoint and deal out what was set aside */
+int _count_parallel(struct count_job *job, uint64_t *found) {
+    const struct count_opts *opts = job->opts;
+    uint64_t before = *found;
+    int res = COUNT_DONE;
+    while (1) {
+        /* take the stack whole, since a task may be set aside on it as
+         * soon as the first is dealt out */
+        pthread_mutex_lock(&job->lock);
+        struct count_task **tasks = job->pending;
+        int n = job->npending;
+        job->pending = NULL;
+        job->npending = 0;
+        job->cap = 0;
+        pthread_mutex_unlock(&job->lock);
+        for (int i = 0; i < n; i++) {
+            pool_submit(opts->pool, _count_task, tasks[i]);
+        }
+        free(tasks);
+        pool_wait(opts->pool);
+        *found = before;
+        for (int i = 0; i < job->nworkers; i++) {
+            *found += job->workers[i].count;
+        }
+        if (job->failed) {
+            return COUNT_NO_MEMORY;
+        }
+        if (!job->draining) {
+            break;
+        }
+        if (!_count_checkpoint(job, *found)) {
+            res = COUNT_STOPPED;
+            break;
+        }
+    }
+    if (solutions_cancelled(&job->workers[0].sink)) {
+        res = COUNT_STOPPED;
+    }
+    return res;
+}
+
+/* the digits still open to each blank cell of a grid (bit d - 1 for digit
+ * d), and the blank cell with the fewest, or -1 if there are no blanks.
+ * returns 0 if the filled cells already clash */
+int _count_open(const struct count_job *job, const uint8_t *cells,
+                uint32_t *open, int *best) {
+    uint32_t used[3][GRID_SIDE_MAX];
+    int side = job->side;
+    int fewest = side + 1;
+    memset(used, 0, sizeof used);
+    for (int i = 0; i < side * side; i++) {
+        int x = i % side;
+        int y = i / side;
+        int b = y / job->box * job->box + x / job->box;
+        uint32_t bit = cells[i] ? 1U << (cells[i] - 1) : 0;
+        if ((used[0][y] | used[1][x] | used[2][b]) & bit) {
+            return 0;
+        }
+        used[0][y] |= bit;
+        used[1][x] |= bit;
+        used[2][b] |= bit;
+    }
+    *best = -1;
+    for (int i = 0; i < side * side; i++) {
+        int x = i % side;
+        int y = i / side;
+        int b = y / job->box * job->box + x / job->box;
+        if (cells[i]) {
+            continue;
+        }
+        open[i] = ((1U << side) - 1) & ~(used[0][y] | used[1][x] | used[2][b]);
+        if (__builtin_popcount(open[i]) < fewest) {
+            fewest = __builtin_popcount(open[i]);
+            *best = i;
+        }
+    }
+    return 1;
+}
+
+/* open the tree out from the root, breadth first, into at least want
+ * subproblems, or as many as there are, which are left on the job's
+ * stack. grids which are filled in on the way are solutions, and are
+ * counted in *solved rather than kept */
+void _count_frontier(struct count_job *job, const uint8_t *cells, int want,
+                     uint64_t *solved) {
+    uint32_t open[GRID_CELLS_MAX];
+    int head = 0;
+    int best;
+    if (!_count_open(job, cells, open, &best)) {
+        return;
+    }
+    _count_set_aside(job, _count_task_new(job, cells));
+    while (head < job->npending && job->npending - head < want) {
+        struct count_task *t = job->pending[head++];
+        _count_open(job, t->cells, open, &best);
+        if (best < 0) {
+            (*solved)++;
+        }
+        for (uint32_t bits = best < 0 ? 0 : open[best]; bits;
+             bits &= bits - 1) {
+            t->cells[best] = __builtin_ctz(bits) + 1;
+            _count_set_aside(job, _count_task_new(job, t->cells));
+        }
+        free(t);
+    }
+    memmove(job->pending, job->pending + head,
+            (job->npending - head) * sizeof *job->pending);
+    job->npending -= head;
+}
+
+/* returns 0 if out of memory */
+int _count_job_init(struct count_job *job, int box,
+                    const struct count_opts *opts) {
+    const struct search_opts *search = opts->search ? opts->search :
+                                                      &search_defaults;
+    memset(job, 0, sizeof *job);
+    job->box = box;
+    job->side = box * box;
+    job->opts = opts;
+    job->nworkers = opts->pool ? opts->pool->nworkers : 1;
+    job->workers = calloc(job->nworkers, sizeof *job->workers);
+    if (!job->workers) {
+        return 0;
+    }
+    job->due = _count_now() + opts->every;
+    pthread_mutex_init(&job->lock, NULL);
+    for (int i = 0; i < job->nworkers; i++) {
+        struct count_worker *w = &job->workers[i];
+        w->job = job;
+        w->index = i;
+        w->opts = *search;
+        w->opts.space = opts->spaces[i];
+        w->opts.stats = search->stats ? &w->stats : NULL;
+        w->opts.solutions = &w->sink;
+        w->sink.fn = opts->fn && !opts->pool ? _count_solution : NULL;
+        w->sink.arg = w;
+        /* with checkpoints, a cancel drains the job instead, through
+         * _count_wanted */
+        w->sink.cancel = opts->checkpoint ? NULL : opts->cancel;
+        if (opts->pool || opts->checkpoint) {
+            w->sink.wanted = _count_wanted;
+            w->sink.give = _count_give;
+        }
+        stats_reset(&w->stats);
+    }
+    return 1;
+}
+
+void _count_job_free(struct count_job *job) {
+    for (int i = 0; i < job->npending; i++) {
+        free(job->pending[i]);
+    }
+    free(job->pending);
+    free(job->workers);
+    pthread_mutex_destroy(&job->lock);
+}
+
+int _count_job_run(struct count_job *job, uint64_t *found) {
+    const struct search_opts *search = job->opts->search;
+    int res = job->opts->pool ? _count_parallel(job, found) :
+                                _count_serial(job, found);
+    for (int i = 0; i < job->nworkers; i++) {
+        if (search && search->stats) {
+            stats_add(search->stats, &job->workers[i].stats);
+        }
+    }
+    _count_job_free(job);
+    return res;
+}
+
+/* count the solutions of a grid with boxes of side box, given as one digit
+ * per cell in row major order, with the search options for 9x9 grids
+ * (other sizes always use dancing links) taken from opts->search, and
+ * counters added to its stats. returns COUNT_DONE with the count in
+ * found, COUNT_STOPPED with the count so far, or COUNT_NO_MEMORY. a pool
+ * must not be running anything else */
+int count_run(int box, const uint8_t *cells, const struct count_opts *opts,
+              uint64_t *found) {
+    struct count_job job;
+    *found = 0;
+    if (!_count_job_init(&job, box, opts)) {
+        return COUNT_NO_MEMORY;
+    }
+    if (opts->pool) {
+        _count_frontier(&job, cells, job.nworkers *
+                        COUNT_FRONTIER_PER_THREAD, found);
+    } else {
+        _count_set_aside(&job, _count_task_new(&job, cells));
+    }
+    return _count_job_run(&job, found);
+}
+
+/* the next line of a state, as a string of up to max characters, or NULL
+ * if there is none that short */
+const char *_count_line(const char **state, char *line, size_t max) {
+    const char *end = strchr(*state, '\n');
+    size_t len = end ? (size_t) (end - *state) : strlen(*state);
+    if (!len || len > max) {
+        return NULL;
+    }
+    memcpy(line, *state, len);
+    line[len] = '\0';
+    *state += end ? len + 1 : len;
+    return line;
+}
+
+/* take up a job from the state handed to a checkpoint, with the same
+ * options as count_run (which need not be those it was started with).
+ * returns as count_run, with the count including that found before the
+ * checkpoint, or COUNT_BAD_STATE if the state cannot be read */
+int count_resume(const char *state, const struct count_opts *opts,
+                 uint64_t *found) {
+    char line[GRID_CELLS_MAX + 1];
+    struct count_job job;
+    struct grid g;
+    unsigned long long before;
+    int box;
+    int n;
+    if (!_count_line(&state, line, sizeof line - 1) ||
+        strcmp(line, COUNT_STATE_MAGIC) != 0 ||
+        !_count_line(&state, line, sizeof line - 1) ||
+        sscanf(line, "box %d", &box) != 1 ||
+        box < DLX_BOX_MIN || box > DLX_BOX_MAX ||
+        !_count_line(&state, line, sizeof line - 1) ||
+        sscanf(line, "found %llu", &before) != 1 ||
+        !_count_line(&state, line, sizeof line - 1) ||
+        sscanf(line, "grids %d", &n) != 1 || n < 0) {
+        return COUNT_BAD_STATE;
+    }
+    if (!_count_job_init(&job, box, opts)) {
+        return COUNT_NO_MEMORY;
+    }
+    for (int i = 0; i < n; i++) {
+        if (!_count_line(&state, line, sizeof line - 1) ||
+            !grid_parse_line(&g, line) || g.box != box) {
+            _count_job_free(&job);
+            return COUNT_BAD_STATE;
+        }
+        _count_set_aside(&job, _count_task_new(&job, g.cells));
+    }
+    *found = before;
+    return _count_job_run(&job, found);
+}
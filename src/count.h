@@ -0,0 +1,77 @@
+#ifndef __COUNT_H__
+#define __COUNT_H__
+
+#include <stdint.h>
+
+#include "backtrack.h"
+#include "pool.h"
+#include "solutions.h"
+
+/* counting every solution of a grid as a job of subproblems: grids, each
+ * the grid with more of its cells filled in, which never overlap and
+ * together cover the whole search tree, so that their counts add up to
+ * exactly the count of the grid.
+ *
+ * across the workers of a pool, the tree is first opened out, breadth
+ * first, into a frontier of at least COUNT_FRONTIER_PER_THREAD
+ * subproblems per worker, which are dealt out over the pool. after that,
+ * whenever a worker goes idle with nothing left to steal, the next search
+ * to poll the pool gives away the untried alternatives of its shallowest
+ * guess (see solutions.h), which are queued on its own worker for the
+ * idle ones to steal. on the calling thread, the job is a stack of
+ * subproblems, worked through in the order a single search would take.
+ *
+ * the job can also be checkpointed: every so often, and when it is
+ * cancelled, each search gives away all the work it has left and stops,
+ * and subproblems not yet started are set aside. what is set aside, with
+ * the count so far, is the state of the job, which is handed to the
+ * checkpoint callback as text:
+ *
+ *   pseudoku-checkpoint 1
+ *   box B
+ *   found N
+ *   grids M
+ *
+ * followed by M grids in single line format, one per line. the job then
+ * picks up where it was, or, from the state, can be started again in
+ * another process with count_resume. the pause takes a node of each
+ * search and a few microseconds, and the clock is only read every
+ * COUNT_POLL_CLOCK polls, so a checkpoint a minute costs nothing that can
+ * be measured. the cancel flag is polled at every node either way; with
+ * checkpoints, a cancel drains the job, and the state goes to the
+ * callback before the job returns */
+#define COUNT_FRONTIER_PER_THREAD 16
+#define COUNT_POLL_CLOCK 4096
+#define COUNT_STATE_MAGIC "pseudoku-checkpoint 1"
+
+#define COUNT_DONE 0
+#define COUNT_STOPPED 1 /* by the limit, the callback or a cancel */
+#define COUNT_BAD_STATE -1
+#define COUNT_NO_MEMORY -2
+
+/* called with the state of a job at each checkpoint; returns nonzero to
+ * stop the job there */
+typedef int (*count_checkpoint_fn)(const char *state, void *arg);
+
+struct count_opts {
+    const struct search_opts *search; /* the engine, for 9x9 grids */
+    struct pool *pool; /* NULL to count on the calling thread */
+    struct workspace **spaces; /* one per worker, or one for the caller */
+    const int *cancel; /* if not NULL, stops the job once set */
+    /* on the calling thread only: solutions past limit (0 for none) are
+     * not looked for, and fn, if not NULL, sees each solution */
+    uint64_t limit;
+    solution_fn fn;
+    void *arg;
+    double every; /* seconds between checkpoints, 0 for none */
+    count_checkpoint_fn checkpoint;
+    void *checkpoint_arg;
+};
+
+void count_opts_init(struct count_opts *opts);
+int count_run(int box, const uint8_t *cells, const struct count_opts *opts,
+              uint64_t *found);
+int count_resume(const char *state, const struct count_opts *opts,
+                 uint64_t *found);
+
+#endif
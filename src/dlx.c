@@ -0,0 +1,133 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dlx.h"
+#include "board.h"
+#include "constants.h"
+
+/* the whole matrix lives in one fixed size arena of nodes, linked by index
+ * rather than by pointer. node 0 is the root, nodes 1 to the number of
+ * columns are the column headers (whose column is themselves), and the
+ * rest are the nodes of the rows, four to a row. only the rows and columns
+ * still open once the givens are placed are linked in, so a search starts
+ * with the givens' columns already covered.
+ *
+ * the engine is instantiated once for each box side from dlx_sized.h, so
+ * that every loop bound and table size is a constant. node indices are
+ * 16 bits wide, which is just enough for 25x25 (65001 nodes); masks of
+ * allowed digits are 16 bits wide up to 16x16, and 32 bits beyond */
+
+#define DLX_BOX 2
+#define DLX_MASK uint16_t
+#include "dlx_sized.h"
+
+#define DLX_BOX 3
+#define DLX_MASK uint16_t
+#include "dlx_sized.h"
+
+#define DLX_BOX 4
+#define DLX_MASK uint16_t
+#include "dlx_sized.h"
+
+#define DLX_BOX 5
+#define DLX_MASK uint32_t
+#include "dlx_sized.h"
+
+static const size_t _dlx_sizes[DLX_BOX_MAX + 1] = {
+    0, 0, sizeof(struct dlx_2), sizeof(struct dlx_3), sizeof(struct dlx_4),
+    sizeof(struct dlx_5)
+};
+
+/* an arena of size bytes for box, from arenas if given, or else fresh */
+void *_dlx_arena(struct dlx_arenas *arenas, int box, size_t size) {
+    if (!arenas) {
+        return malloc(size);
+    }
+    if (!arenas->box[box]) {
+        arenas->box[box] = malloc(size);
+    }
+    return arenas->box[box];
+}
+
+/* allocate the arena for box ahead of the first search which needs it.
+ * returns 0 if out of memory */
+int dlx_arenas_reserve(struct dlx_arenas *arenas, int box) {
+    return _dlx_arena(arenas, box, _dlx_sizes[box]) != NULL;
+}
+
+/* count the solutions to a puzzle (whose pencil marks must be filled in),
+ * stopping once max have been found, leaving the first one found in puz.
+ * the same contract as puzzle_search, which this backs when asked for
+ * ENGINE_DLX; only the digits left in each cell's pencil marks are tried.
+ * the matrix goes in arenas if given (see dlx_search_sized), and the
+ * solutions are handed to out if given. returns DLX_NO_MEMORY if there is
+ * no room for the matrix */
+uint64_t dlx_search(puzzle puz, uint64_t max, struct stats *stats,
+                    struct dlx_arenas *arenas, const struct solutions *out) {
+    struct dlx_3 *x = _dlx_arena(arenas, 3, sizeof *x);
+    uint8_t cells[BOARD_LENGTH];
+    uint16_t allowed[BOARD_LENGTH];
+    if (!x) {
+        return DLX_NO_MEMORY;
+    }
+    for (int i = 0; i < BOARD_LENGTH; i++) {
+        struct cell *c = &puz[CELL_X(i)][CELL_Y(i)];
+        cells[i] = c->complete ? c->u.ink : 0;
+        allowed[i] = c->complete ? 0 : c->u.pencil;
+    }
+    uint64_t count = _dlx_search_3(x, cells, allowed, max, stats, out);
+    for (int i = 0; count && i < BOARD_LENGTH; i++) {
+        struct cell *c = &puz[CELL_X(i)][CELL_Y(i)];
+        c->complete = 1;
+        c->u.ink = cells[i];
+    }
+    if (!arenas) {
+        free(x);
+    }
+    return count;
+}
+
+/* as dlx_search, for a board with boxes of side box, given as one digit
+ * per cell in row major order (0 for blank). the first solution found is
+ * left in cells. the matrices run from kilobytes to hundreds of
+ * kilobytes, too much for the stack of every call, so they go in arenas if
+ * given, where they are only allocated once, or are allocated afresh.
+ * returns DLX_NO_MEMORY if there is no room for the matrix */
+uint64_t dlx_search_sized(int box, uint8_t *cells, uint64_t max,
+                          struct stats *stats, struct dlx_arenas *arenas,
+                          const struct solutions *out) {
+    uint64_t count = 0;
+    assert(box >= DLX_BOX_MIN && box <= DLX_BOX_MAX);
+    void *x = _dlx_arena(arenas, box, _dlx_sizes[box]);
+    if (!x) {
+        return DLX_NO_MEMORY;
+    }
+    switch (box) {
+        case 2:
+            count = _dlx_search_2(x, cells, NULL, max, stats, out);
+            break;
+        case 3:
+            count = _dlx_search_3(x, cells, NULL, max, stats, out);
+            break;
+        case 4:
+            count = _dlx_search_4(x, cells, NULL, max, stats, out);
+            break;
+        case 5:
+            count = _dlx_search_5(x, cells, NULL, max, stats, out);
+            break;
+        default:
+            assert(0);
+    }
+    if (!arenas) {
+        free(x);
+    }
+    return count;
+}
+
+void dlx_arenas_free(struct dlx_arenas *arenas) {
+    for (int box = 0; box <= DLX_BOX_MAX; box++) {
+        free(arenas->box[box]);
+        arenas->box[box] = NULL;
+    }
+}
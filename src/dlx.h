@@ -0,0 +1,39 @@
+#ifndef __DLX_H__
+#define __DLX_H__
+
+#include <stdint.h>
+
+#include "cell.h"
+#include "stats.h"
+#include "solutions.h"
+
+/* sudoku as an exact cover problem, solved with knuth's dancing links.
+ * for a board of side s (a box side squared), there is a column for each
+ * cell, and for each digit in each row, column and box (4 * s * s in all),
+ * and a row for each digit in each cell (s * s * s), which covers the four
+ * columns the placement satisfies. this is the one engine which handles
+ * every board size, from 4x4 up to 25x25 */
+#define DLX_BOX_MIN 2
+#define DLX_BOX_MAX 5
+#define DLX_WANTED_EVERY 16 /* steps between polls of a sink's wanted */
+
+/* returned by the searches in place of a count when they could not get
+ * the memory for their matrix */
+#define DLX_NO_MEMORY UINT64_MAX
+
+/* arenas for the matrices, kept between searches by whoever owns them, so
+ * that a search does not have to allocate its matrix, or put it on the
+ * stack. they start out zeroed, and are released with dlx_arenas_free */
+struct dlx_arenas {
+    void *box[DLX_BOX_MAX + 1];
+};
+
+int dlx_arenas_reserve(struct dlx_arenas *arenas, int box);
+uint64_t dlx_search(puzzle puz, uint64_t max_solutions, struct stats *stats,
+                    struct dlx_arenas *arenas, const struct solutions *out);
+uint64_t dlx_search_sized(int box, uint8_t *cells, uint64_t max_solutions,
+                          struct stats *stats, struct dlx_arenas *arenas,
+                          const struct solutions *out);
+void dlx_arenas_free(struct dlx_arenas *arenas);
+
+#endif
@@ -0,0 +1,297 @@
+/* the dancing links engine, for one size of board. this is a template
+ * rather than a header: it has no include guard, and is included once per
+ * size by dlx.c with DLX_BOX defined as the box side (2 to 5), giving a
+ * set of functions suffixed with the box side, with every size and table
+ * fixed at compile time. see dlx.c for how the matrix is laid out */
+
+#define DLX_SIDE (DLX_BOX * DLX_BOX)
+#define DLX_CELLS (DLX_SIDE * DLX_SIDE)
+#define DLX_COLS (4 * DLX_CELLS)
+#define DLX_ALL_NODES (1 + DLX_COLS + 4 * DLX_SIDE * DLX_CELLS)
+#define DLX_PASTE(name, box) name##_##box
+#define DLX_EXPAND(name, box) DLX_PASTE(name, box)
+#define DLX_NAME(name) DLX_EXPAND(name, DLX_BOX)
+
+struct DLX_NAME(dlx) {
+    uint16_t l[DLX_ALL_NODES];
+    uint16_t r[DLX_ALL_NODES];
+    uint16_t u[DLX_ALL_NODES];
+    uint16_t d[DLX_ALL_NODES];
+    uint16_t col[DLX_ALL_NODES];
+    uint16_t row[DLX_ALL_NODES]; /* cell * side + digit - 1 */
+    uint16_t size[1 + DLX_COLS];
+    int len; /* nodes in use */
+};
+
+/* the four columns covered by placing digit n (from 1) in a cell */
+void DLX_NAME(_dlx_columns)(int cell, int n, int cols[4]) {
+    int x = cell % DLX_SIDE;
+    int y = cell / DLX_SIDE;
+    int box = (y / DLX_BOX) * DLX_BOX + x / DLX_BOX;
+    int d = n - 1;
+    cols[0] = 1 + cell;
+    cols[1] = 1 + DLX_CELLS + y * DLX_SIDE + d;
+    cols[2] = 1 + 2 * DLX_CELLS + x * DLX_SIDE + d;
+    cols[3] = 1 + 3 * DLX_CELLS + box * DLX_SIDE + d;
+}
+
+void DLX_NAME(_dlx_add_row)(struct DLX_NAME(dlx) *x, int cell, int n,
+                            int cols[4]) {
+    int first = x->len;
+    for (int i = 0; i < 4; i++) {
+        int node = x->len++;
+        int c = cols[i];
+        x->col[node] = c;
+        x->row[node] = cell * DLX_SIDE + n - 1;
+        x->u[node] = x->u[c];
+        x->d[node] = c;
+        x->d[x->u[c]] = node;
+        x->u[c] = node;
+        x->size[c]++;
+        x->l[node] = i ? node - 1 : first + 3;
+        x->r[node] = i < 3 ? node + 1 : first;
+    }
+}
+
+/* build the matrix for a board, with a row for each digit allowed in each
+ * blank cell (bit n - 1 of allowed[cell], or every digit if allowed is
+ * NULL). returns 0 if the givens clash */
+int DLX_NAME(_dlx_build)(struct DLX_NAME(dlx) *x, const uint8_t *cells,
+                         const DLX_MASK *allowed) {
+    uint8_t given[1 + DLX_COLS];
+    int cols[4];
+    memset(given, 0, sizeof given);
+    for (int cell = 0; cell < DLX_CELLS; cell++) {
+        if (!cells[cell]) {
+            continue;
+        }
+        DLX_NAME(_dlx_columns)(cell, cells[cell], cols);
+        for (int i = 0; i < 4; i++) {
+            if (given[cols[i]]) {
+                return 0;
+            }
+            given[cols[i]] = 1;
+        }
+    }
+
+    int prev = 0;
+    for (int c = 1; c <= DLX_COLS; c++) {
+        x->u[c] = x->d[c] = x->col[c] = c;
+        x->size[c] = 0;
+        if (!given[c]) {
+            x->l[c] = prev;
+            x->r[prev] = c;
+            prev = c;
+        }
+    }
+    x->r[prev] = 0;
+    x->l[0] = prev;
+    x->len = 1 + DLX_COLS;
+
+    for (int cell = 0; cell < DLX_CELLS; cell++) {
+        if (cells[cell]) {
+            continue;
+        }
+        for (int n = 1; n <= DLX_SIDE; n++) {
+            if (allowed && !(allowed[cell] & ((DLX_MASK) 1 << (n - 1)))) {
+                continue;
+            }
+            DLX_NAME(_dlx_columns)(cell, n, cols);
+            if (!given[cols[1]] && !given[cols[2]] && !given[cols[3]]) {
+                DLX_NAME(_dlx_add_row)(x, cell, n, cols);
+            }
+        }
+    }
+    return 1;
+}
+
+void DLX_NAME(_dlx_cover)(struct DLX_NAME(dlx) *x, int c) {
+    x->r[x->l[c]] = x->r[c];
+    x->l[x->r[c]] = x->l[c];
+    for (int i = x->d[c]; i != c; i = x->d[i]) {
+        for (int j = x->r[i]; j != i; j = x->r[j]) {
+            x->d[x->u[j]] = x->d[j];
+            x->u[x->d[j]] = x->u[j];
+            x->size[x->col[j]]--;
+        }
+    }
+}
+
+void DLX_NAME(_dlx_uncover)(struct DLX_NAME(dlx) *x, int c) {
+    for (int i = x->u[c]; i != c; i = x->u[i]) {
+        for (int j = x->l[i]; j != i; j = x->l[j]) {
+            x->size[x->col[j]]++;
+            x->d[x->u[j]] = j;
+            x->u[x->d[j]] = j;
+        }
+    }
+    x->r[x->l[c]] = c;
+    x->l[x->r[c]] = c;
+}
+
+/* the open column with the fewest rows left */
+int DLX_NAME(_dlx_choose)(struct DLX_NAME(dlx) *x) {
+    int best = x->r[0];
+    for (int c = x->r[best]; c != 0 && x->size[best] > 1; c = x->r[c]) {
+        if (x->size[c] < x->size[best]) {
+            best = c;
+        }
+    }
+    return best;
+}
+
+/* give away work (see solutions.h): the rows left after the shallowest
+ * chosen row which has any, or with all, those after every chosen row,
+ * followed by the node itself if it is live. each goes as the givens, the
+ * rows chosen above it, and the row itself. returns the depth above which
+ * there is nothing left to try */
+int DLX_NAME(_dlx_give_away)(struct DLX_NAME(dlx) *x, const uint8_t *givens,
+                             const uint16_t *chosen, int base, int k,
+                             const struct solutions *out, int all,
+                             int live) {
+    uint8_t cells[DLX_CELLS];
+    uint16_t rest[DLX_SIDE];
+    memcpy(cells, givens, DLX_CELLS);
+    for (int level = 0; level < k; level++) {
+        int n = 0;
+        if (level >= base) {
+            int c = x->col[chosen[level]];
+            for (int row = x->d[chosen[level]]; row != c; row = x->d[row]) {
+                rest[n++] = row;
+            }
+        }
+        for (int j = n - 1; j >= 0; j--) {
+            int r = x->row[rest[j]];
+            cells[r / DLX_SIDE] = r % DLX_SIDE + 1;
+            out->give(cells, out->arg);
+            cells[r / DLX_SIDE] = 0;
+        }
+        int r = x->row[chosen[level]];
+        cells[r / DLX_SIDE] = r % DLX_SIDE + 1;
+        if (n && !all) {
+            return level + 1;
+        }
+    }
+    if (all && live) {
+        out->give(cells, out->arg);
+    }
+    return k;
+}
+
+/* count the solutions of a board, given as one digit per cell in row major
+ * order (0 for blank), stopping once max have been found, and leaving the
+ * first one found in cells. each solution is also handed to out, if given,
+ * which can stop the search early (see solutions.h). nodes counts the rows
+ * tried, guesses the columns covered with more than one row to try */
+uint64_t DLX_NAME(_dlx_search)(struct DLX_NAME(dlx) *x, uint8_t *cells,
+                               const DLX_MASK *allowed, uint64_t max,
+                               struct stats *stats,
+                               const struct solutions *out) {
+    uint16_t chosen[DLX_CELLS];
+    uint8_t solution[DLX_CELLS];
+    uint8_t givens[DLX_CELLS];
+    int k = 0;
+    int base = 0; /* every level shallower than this is done with */
+    uint64_t count = 0;
+    int forward = 1;
+    int row;
+    if (max == 0 || !DLX_NAME(_dlx_build)(x, cells, allowed)) {
+        return 0;
+    }
+    if (out && out->fn) {
+        memcpy(solution, cells, DLX_CELLS);
+    }
+    /* the sink's polls are on every step, so test for them once up front.
+     * a step is cheap enough that calling wanted on each would show, so it
+     * is only called on every DLX_WANTED_EVERY-th */
+    const int *cancel = out ? out->cancel : NULL;
+    int splits = out && out->wanted;
+    unsigned polls = 0;
+    if (splits) {
+        memcpy(givens, cells, DLX_CELLS);
+    }
+    while (!(cancel && __atomic_load_n(cancel, __ATOMIC_RELAXED))) {
+        int split = splits && ++polls % DLX_WANTED_EVERY == 0 ?
+                    out->wanted(out->arg) : SPLIT_NONE;
+        if (split != SPLIT_NONE) {
+            base = DLX_NAME(_dlx_give_away)(x, givens, chosen, base, k, out,
+                                            split == SPLIT_ALL, forward);
+            if (split == SPLIT_ALL) {
+                break;
+            }
+        }
+        if (forward && x->r[0] == 0) {
+            if (count++ == 0) {
+                for (int i = 0; i < k; i++) {
+                    int r = x->row[chosen[i]];
+                    cells[r / DLX_SIDE] = r % DLX_SIDE + 1;
+                }
+            }
+            if (out && out->fn) {
+                /* the chosen rows are exactly the blank cells */
+                for (int i = 0; i < k; i++) {
+                    int r = x->row[chosen[i]];
+                    solution[r / DLX_SIDE] = r % DLX_SIDE + 1;
+                }
+                if (out->fn(solution, out->arg)) {
+                    break;
+                }
+            }
+            if (count == max) {
+                break;
+            }
+            forward = 0;
+        }
+        if (forward) {
+            int c = DLX_NAME(_dlx_choose)(x);
+            if (stats && x->size[c] > 1) {
+                stats->guesses++;
+            }
+            DLX_NAME(_dlx_cover)(x, c);
+            row = x->d[c];
+        } else {
+            /* take back the latest row, and move on to the next one in
+             * its column */
+            if (k <= base) {
+                /* every level left has been tried or given away */
+                break;
+            }
+            if (stats) {
+                stats->backtracks++;
+            }
+            row = chosen[--k];
+            for (int j = x->l[row]; j != row; j = x->l[j]) {
+                DLX_NAME(_dlx_uncover)(x, x->col[j]);
+            }
+            row = x->d[row];
+        }
+        if (row == x->col[row]) {
+            /* back at the header: no rows left in this column */
+            DLX_NAME(_dlx_uncover)(x, row);
+            forward = 0;
+            continue;
+        }
+        chosen[k++] = row;
+        for (int j = x->r[row]; j != row; j = x->r[j]) {
+            DLX_NAME(_dlx_cover)(x, x->col[j]);
+        }
+        if (stats) {
+            stats->nodes++;
+            if ((uint64_t) k > stats->max_depth) {
+                stats->max_depth = k;
+            }
+        }
+        forward = 1;
+    }
+    return count;
+}
+
+#undef DLX_SIDE
+#undef DLX_CELLS
+#undef DLX_COLS
+#undef DLX_ALL_NODES
+#undef DLX_PASTE
+#undef DLX_EXPAND
+#undef DLX_NAME
+#undef DLX_BOX
+#undef DLX_MASK
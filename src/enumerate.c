@@ -0,0 +1,309 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "enumerate.h"
+#include "pseudoku.h"
+
+/* the context searching, for the interrupt handler to cancel */
+struct pseudoku *volatile _enumerate_ctx;
+volatile sig_atomic_t _enumerate_interrupted;
+
+/* the run's progress, as far as a checkpoint is concerned: grid is the
+ * one in progress (or next), counting from 0, and invalid and total are
+ * for the grids before it */
+struct enumerate_sink {
+    FILE *out;
+    int box;
+    char line[PSEUDOKU_LINE_MAX + 1];
+    enum enumerate_mode mode;
+    const struct enumerate_opts *opts;
+    unsigned long grid;
+    unsigned long invalid;
+    uint64_t total;
+    int saved; /* whether the grid in progress has a checkpoint */
+    int failed; /* whether a checkpoint could not be written */
+    double due;
+};
+
+const char *_enumerate_modes[] = { "count", "enumerate" };
+
+void enumerate_opts_init(struct enumerate_opts *opts) {
+    opts->limit = 0;
+    opts->engine = "logic";
+    opts->threads = 1;
+    opts->show_stats = 0;
+    opts->checkpoint = NULL;
+    opts->every = 60;
+    opts->resume = NULL;
+}
+
+double _enumerate_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+void _enumerate_interrupt(int sig) {
+    (void) sig;
+    _enumerate_interrupted = 1;
+    if (_enumerate_ctx) {
+        pseudoku_cancel(_enumerate_ctx);
+    }
+}
+
+/* write a solution as it is found. a failed write (say, a closed pipe)
+ * stops the search, since nothing more can be written */
+int _enumerate_write(const uint8_t *cells, void *arg) {
+    struct enumerate_sink *sink = arg;
+    int len = pseudoku_format(sink->box, cells, sink->line);
+    sink->line[len++] = '\n';
+    fwrite(sink->line, 1, len, sink->out);
+    return ferror(sink->out);
+}
+
+/* write a checkpoint of the run, with the state of the grid in progress
+ * if it has one. the file is written beside the old one, synced and
+ * renamed over it, so that whenever the run dies there is one whole
+ * checkpoint. returns 0, or -1 (once reported) if it cannot be written */
+int _enumerate_save(struct enumerate_sink *sink, const char *state) {
+    const char *path = sink->opts->checkpoint;
+    char tmp[4096];
+    FILE *f;
+    fflush(sink->out);
+    long offset = ftell(sink->out);
+    sink->due = _enumerate_now() + sink->opts->every;
+    if (snprintf(tmp, sizeof tmp, "%s.tmp", path) >= (int) sizeof tmp ||
+        !(f = fopen(tmp, "w"))) {
+        goto fail;
+    }
+    fprintf(f, "%s\nmode %s\ngrid %lu\ninvalid %lu\ntotal %llu\n"
+            "output %ld\n%s", ENUMERATE_CHECKPOINT_MAGIC,
+            _enumerate_modes[sink->mode], sink->grid, sink->invalid,
+            (unsigned long long) sink->total, offset, state ? state : "");
+    if (fflush(f) || fsync(fileno(f)) || ferror(f)) {
+        fclose(f);
+        goto fail;
+    }
+    if (fclose(f) || rename(tmp, path)) {
+        goto fail;
+    }
+    return 0;
+fail:
+    if (!sink->failed) {
+        perror(path);
+    }
+    sink->failed = 1;
+    return -1;
+}
+
+/* the library's checkpoint of the grid in progress. a checkpoint which
+ * cannot be written does not stop the run */
+int _enumerate_checkpoint(const char *state, void *arg) {
+    struct enumerate_sink *sink = arg;
+    _enumerate_save(sink, state);
+    sink->saved = 1;
+    return 0;
+}
+
+/* read a checkpoint written by _enumerate_save back into the sink, with
+ * the output offset in offset and the state of the grid in progress, if
+ * any, in state, which points into the returned buffer. returns NULL if
+ * the file cannot be read, or is not a checkpoint of a run in this mode */
+char *_enumerate_load(struct enumerate_sink *sink, const char *path,
+                      long *offset, const char **state) {
+    char magic[32];
+    char mode[16];
+    unsigned long long total;
+    int len = 0;
+    long size;
+    char *buf;
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return NULL;
+    }
+    if (fseek(f, 0, SEEK_END) || (size = ftell(f)) < 0 ||
+        fseek(f, 0, SEEK_SET) || !(buf = malloc(size + 1))) {
+        fclose(f);
+        return NULL;
+    }
+    buf[fread(buf, 1, size, f)] = '\0';
+    fclose(f);
+    if (sscanf(buf, "%31s %*d mode %15s grid %lu invalid %lu total %llu "
+               "output %ld%n", magic, mode, &sink->grid, &sink->invalid,
+               &total, offset, &len) < 6 || !len ||
+        strncmp(buf, ENUMERATE_CHECKPOINT_MAGIC "\n",
+                strlen(ENUMERATE_CHECKPOINT_MAGIC) + 1) != 0 ||
+        strcmp(mode, _enumerate_modes[sink->mode]) != 0) {
+        free(buf);
+        return NULL;
+    }
+    sink->total = total;
+    *state = buf[len] == '\n' && buf[len + 1] ? buf + len + 1 : NULL;
+    return buf;
+}
+
+/* put the output back as it was at a checkpoint, dropping whatever was
+ * written after it. only a regular file can be put back; anything else
+ * carries on from where it is */
+void _enumerate_rewind(FILE *out, long offset) {
+    struct stat st;
+    if (offset < 0 || fstat(fileno(out), &st) || !S_ISREG(st.st_mode)) {
+        return;
+    }
+    if (st.st_size < offset) {
+        fputs("output is shorter than at the checkpoint (append to it with "
+              ">>)\n", stderr);
+        return;
+    }
+    fflush(out);
+    if (ftruncate(fileno(out), offset) == 0) {
+        fseek(out, offset, SEEK_SET);
+    }
+}
+
+int enumerate_run(enum enumerate_mode mode, FILE *in, FILE *out,
+                  const struct enumerate_opts *opts) {
+    struct pseudoku *ctx = pseudoku_new();
+    struct enumerate_sink sink;
+    uint8_t cells[PSEUDOKU_CELLS_MAX];
+    unsigned long grids = 0;
+    unsigned long invalid = 0;
+    uint64_t total = 0;
+    char *saved = NULL;
+    const char *state = NULL;
+    int bad = 0;
+    struct sigaction sa;
+    struct sigaction old;
+    struct timespec start;
+    struct timespec end;
+    if (!ctx) {
+        return 1;
+    }
+    if (pseudoku_set_engine(ctx, opts->engine) < 0) {
+        pseudoku_free(ctx);
+        return -1;
+    }
+    pseudoku_set_stats(ctx, opts->show_stats);
+    pseudoku_set_threads(ctx, opts->threads);
+    memset(&sink, 0, sizeof sink);
+    sink.out = out;
+    sink.mode = mode;
+    sink.opts = opts;
+    if (opts->resume) {
+        long offset;
+        if (!(saved = _enumerate_load(&sink, opts->resume, &offset, &state))) {
+            fprintf(stderr, "%s: not a checkpoint of %s\n", opts->resume,
+                    _enumerate_modes[mode]);
+            pseudoku_free(ctx);
+            return 1;
+        }
+        _enumerate_rewind(out, offset);
+        invalid = sink.invalid;
+        total = sink.total;
+        while (grids < sink.grid && pseudoku_read(in, cells)) {
+            grids++;
+        }
+    }
+    if (opts->checkpoint) {
+        pseudoku_set_checkpoint(ctx, opts->every, _enumerate_checkpoint,
+                                &sink);
+        sink.due = _enumerate_now() + opts->every;
+    }
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = _enumerate_interrupt;
+    sigemptyset(&sa.sa_mask);
+    _enumerate_ctx = ctx;
+    _enumerate_interrupted = 0;
+    sigaction(SIGINT, &sa, &old);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int box;
+    while (!_enumerate_interrupted && !ferror(out)) {
+        uint64_t found;
+        if (opts->checkpoint && opts->every > 0 &&
+            _enumerate_now() >= sink.due) {
+            _enumerate_save(&sink, NULL);
+        }
+        if (!(box = pseudoku_read(in, cells))) {
+            break;
+        }
+        grids++;
+        sink.saved = 0;
+        if (box < 0) {
+            invalid++;
+            sink.grid++;
+            sink.invalid++;
+            fputs(mode == ENUMERATE_LIST ? "# invalid\n" : "invalid\n", out);
+            continue;
+        }
+        sink.box = box;
+        pseudoku_solution_fn fn = mode == ENUMERATE_LIST ? _enumerate_write :
+                                                           NULL;
+        int res;
+        if (state) {
+            res = pseudoku_resume(ctx, state, opts->limit, fn, &sink, &found);
+            state = NULL;
+            if (res == PSEUDOKU_INVALID) {
+                fprintf(stderr, "%s: bad checkpoint\n", opts->resume);
+                bad = 1;
+                break;
+            }
+        } else {
+            res = pseudoku_enumerate(ctx, box, cells, opts->limit, fn, &sink,
+                                     &found);
+        }
+        if (res == PSEUDOKU_NO_MEMORY) {
+            fprintf(stderr, "out of memory\n");
+            bad = 1;
+            break;
+        }
+        total += found;
+        const char *more = res == PSEUDOKU_STOPPED ? "+" : "";
+        if (mode == ENUMERATE_LIST) {
+            fprintf(out, "# %llu%s solution%s\n", (unsigned long long) found,
+                    more, found == 1 && !*more ? "" : "s");
+        } else {
+            fprintf(out, "%llu%s\n", (unsigned long long) found, more);
+        }
+        /* a grid cut short by the interrupt keeps its checkpoint, so that
+         * it is taken up again from there */
+        if (!(_enumerate_interrupted && sink.saved && *more)) {
+            sink.grid++;
+            sink.total += found;
+            sink.saved = 0;
+        }
+    }
+    if (opts->checkpoint && _enumerate_interrupted && !sink.saved) {
+        _enumerate_save(&sink, NULL);
+    }
+    fflush(out);
+    if (opts->checkpoint && !_enumerate_interrupted && !ferror(out) && !bad) {
+        char tmp[4096];
+        remove(opts->checkpoint);
+        if (snprintf(tmp, sizeof tmp, "%s.tmp", opts->checkpoint) <
+            (int) sizeof tmp) {
+            remove(tmp);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    sigaction(SIGINT, &old, NULL);
+    _enumerate_ctx = NULL;
+    double secs = (end.tv_sec - start.tv_sec) +
+                  (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "%lu grids (%lu invalid), %llu solutions in %.3f s, "
+            "%.0f solutions/s%s\n", grids, invalid,
+            (unsigned long long) total, secs, secs > 0 ? total / secs : 0.0,
+            _enumerate_interrupted ? ", interrupted" : "");
+    if (opts->show_stats) {
+        pseudoku_stats_print(ctx, stderr);
+    }
+    pseudoku_free(ctx);
+    free(saved);
+    return ferror(out) || _enumerate_interrupted || bad ? 1 : 0;
+}
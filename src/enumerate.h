@@ -0,0 +1,56 @@
+#ifndef __ENUMERATE_H__
+#define __ENUMERATE_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* counting and enumerating read grids in single line format, of any
+ * supported size, and stream out what they find as it is found:
+ *
+ * count:     one line per grid, with the number of solutions; a count
+ *            followed by "+" means the search stopped there, at the limit
+ *            or on an interrupt, so there may be more
+ * enumerate: every solution of each grid, one per line in single line
+ *            format, followed by a comment line "# N solutions" (or
+ *            "# N+ solutions", as above), so the output can itself be
+ *            read back as a corpus
+ *
+ * lines which cannot be parsed produce "invalid" ("# invalid" when
+ * enumerating). solutions are written as they are found and never held,
+ * so a grid with millions of them runs in the same memory as a grid with
+ * one. an interrupt (SIGINT) cancels the search in progress, which
+ * returns within a few microseconds with what it has found; what has been
+ * found is written out, and the rest of the input is skipped. a summary
+ * goes to stderr at the end.
+ *
+ * a count with no limit is spread over the threads asked for (see
+ * count.h); enumerating, or counting up to a limit, runs on one.
+ *
+ * with a checkpoint file, the run is saved there every so often, and when
+ * it is interrupted: how far it is through its input and its output, and
+ * the state of the grid in progress (see count.h), so that a long count
+ * can be killed and taken up again, on any number of threads, with the
+ * same input and output. the file is left behind only if the run does not
+ * finish. output already written after the checkpoint is cut off again
+ * when the run is resumed, if it goes to a regular file (opened for
+ * appending, as with >>, so the shell keeps what is there); anything else
+ * sees those lines twice */
+#define ENUMERATE_CHECKPOINT_MAGIC "sudoku-checkpoint 1"
+
+enum enumerate_mode { ENUMERATE_COUNT, ENUMERATE_LIST };
+
+struct enumerate_opts {
+    uint64_t limit; /* solutions per grid, 0 for no limit */
+    const char *engine; /* by name, as pseudoku_set_engine */
+    int threads; /* as pseudoku_set_threads */
+    int show_stats;
+    const char *checkpoint; /* the file to save to, NULL for none */
+    double every; /* seconds between checkpoints */
+    const char *resume; /* a checkpoint to start from, NULL for none */
+};
+
+void enumerate_opts_init(struct enumerate_opts *opts);
+int enumerate_run(enum enumerate_mode mode, FILE *in, FILE *out,
+                  const struct enumerate_opts *opts);
+
+#endif
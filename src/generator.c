@@ -1,5 +1,5 @@
-#include <stdlib.h>
 #include <assert.h>
+#include <string.h>
 #include <time.h>
 
 #include "cell.h"
@@ -7,11 +7,15 @@
 #include "strategy.h"
 #include "backtrack.h"
 #include "constants.h"
+#include "units.h"
+#include "pool.h"
+#include "rating.h"
+#include "generator.h"
 
-void _scramble(int *array, int const len) {
+void _scramble(struct rng *rng, int *array, int const len) {
     if (len > 1) {
         for (int i = 0; i < len - 1; i++) {
-            int j = i + rand() % (len - i);
+            int j = i + rng_below(rng, len - i);
             assert(j >= i && j < len);
             int t = array[i];
             array[i] = array[j];
@@ -20,78 +24,349 @@ void _scramble(int *array, int const len) {
     }
 }
 
-void _random_indices(int *array, int const start, int const end) {
+void _random_indices(struct rng *rng, int *array, int const start,
+                     int const end) {
     const int len = end - start;
     for (int i = 0; i < len; i++) {
         array[i] = i + start;
     }
-    _scramble(array, len);
+    _scramble(rng, array, len);
     /* for (int i = 0; i < len; i++) { */
     /*     printf("num: %i %d\n", i, array[i]); */
     /* } */
 }
 
-void _fill_puzzle(puzzle blank) {
-    // TODO: this does not seem to always terminate
+/* fill a blank grid with a random solution, found by a single search (in
+ * ws, if not NULL) which guesses digits in a random order. every digit
+ * left in a cell by the logic is as likely as any other to be tried first,
+ * but the grids do not come out uniformly: a grid's chance depends on the
+ * shape of the search tree above it, so grids reached through fewer
+ * alternatives are favoured. the search is exhaustive over a finite tree
+ * (at most one guess per cell, with at most nine alternatives each), and a
+ * blank grid has solutions, so it always stops, with a full grid */
+void _fill_puzzle(struct workspace *ws, struct stats *stats, struct rng *rng,
+                  puzzle blank) {
+    struct search_opts opts;
+    search_opts_init(&opts);
+    opts.stats = stats;
+    opts.order = VALUE_RANDOM;
+    opts.rng = rng;
+    opts.space = ws;
+    puzzle_init(blank);
+    int found = puzzle_search(blank, 1, &opts);
+    assert(found == 1);
+    (void) found;
+    assert(puzzle_noninked_count(blank) == 0);
+}
+
+/* the digits inked in each row, column and box of a puzzle */
+struct removal {
+    uint16_t placed[3][GROUP_LENGTH];
+};
+
+/* ink or rub out a digit in the masks of the units of x, y */
+void _removal_toggle(struct removal *r, int x, int y, uint16_t bit) {
+    const uint8_t *units = cell_units[CELL_AT(x, y)];
+    uint16_t *placed = &r->placed[0][0];
+    placed[units[ROW]] ^= bit;
+    placed[units[COL]] ^= bit;
+    placed[units[BOX]] ^= bit;
+}
+
+uint16_t _removal_allowed_at(const struct removal *r, int cell) {
+    const uint8_t *units = cell_units[cell];
+    const uint16_t *placed = &r->placed[0][0];
+    return ALL_POS & ~(placed[units[ROW]] | placed[units[COL]] |
+                       placed[units[BOX]]);
+}
+
+uint16_t _removal_allowed(const struct removal *r, int x, int y) {
+    return _removal_allowed_at(r, CELL_AT(x, y));
+}
+
+/* clear the inked cell at x, y, whose digit must already be out of r's
+ * masks, and give the digit back to the peers which may now hold it. the
+ * cell itself is left with the pencil marks in keep */
+void _removal_clear(const struct removal *r, puzzle puz, int x, int y,
+                    uint16_t keep) {
+    uint16_t bit = ink_to_pencil(puz[x][y].u.ink);
+    int cell = CELL_AT(x, y);
+    puz[x][y].complete = 0;
+    puz[x][y].u.pencil = keep;
+    for (int p = 0; p < PEER_COUNT; p++) {
+        struct cell *c = peer_cell(puz, cell, p);
+        if (!c->complete &&
+            (_removal_allowed_at(r, cell_peers[cell][p]) & bit)) {
+            c->u.pencil |= bit;
+        }
+    }
+}
+
+/* whether the inked cell at x, y holds the only digit its units allow */
+int _removal_forced(const struct removal *r, puzzle puz, int x, int y) {
+    uint16_t bit = ink_to_pencil(puz[x][y].u.ink);
+    return (_removal_allowed(r, x, y) | bit) == bit;
+}
+
+/* whether the puzzle still has a unique solution with the inked cell at x, y
+ * rubbed out. since the solution is known, this only needs a search for a
+ * solution which differs from it at that cell: the cell's digit is left
+ * out of its pencil marks, and any solution found means the clue has to
+ * stay. r and puz are only read, so any number of checks can run against
+ * the same puzzle at once. a cell whose digit is the only one its units
+ * allow needs no search at all; the rest mostly run out of options without
+ * finding anything, which is where the dancing links engine, with its very
+ * cheap steps, does best. the search runs in ws, if not NULL, and its
+ * counters go to stats, if not NULL */
+int _removal_unique(struct workspace *ws, struct stats *stats,
+                    const struct removal *r, puzzle puz, int x, int y) {
+    struct removal rubbed = *r;
+    struct search_opts opts;
     puzzle copy;
+    uint16_t bit = ink_to_pencil(puz[x][y].u.ink);
+    if (_removal_forced(r, puz, x, y)) {
+        return 1;
+    }
+    _removal_toggle(&rubbed, x, y, bit);
+    uint16_t allowed = _removal_allowed(&rubbed, x, y);
+    search_opts_init(&opts);
+    opts.stats = stats;
+    opts.engine = ENGINE_DLX;
+    opts.space = ws;
+    puzzle_copy(puz, copy);
+    _removal_clear(&rubbed, copy, x, y, allowed & ~bit);
+    return puzzle_search(copy, 1, &opts) == 0;
+}
+
+/* rub out the inked cell at x, y for good */
+void _removal_commit(struct removal *r, puzzle puz, int x, int y) {
+    _removal_toggle(r, x, y, ink_to_pencil(puz[x][y].u.ink));
+    _removal_clear(r, puz, x, y, _removal_allowed(r, x, y));
+}
+
+void _removal_init(struct removal *r, puzzle puz) {
+    memset(r, 0, sizeof *r);
+    for (int x = 0; x < GROUP_LENGTH; x++) {
+        for (int y = 0; y < GROUP_LENGTH; y++) {
+            _removal_toggle(r, x, y, ink_to_pencil(puz[x][y].u.ink));
+        }
+    }
+}
 
+/* try removing each of up to max_remove cells of a full grid, in a random
+ * order, keeping each removal that leaves the solution unique. the unit
+ * masks and pencil marks of the puzzle are kept up to date between
+ * removals, so each check just copies them and patches in the one cell and
+ * its peers. every clue left has been found necessary, and clues only
+ * become more necessary as others go, so the puzzle comes out minimal */
+void _remove_cells(struct workspace *ws, struct stats *stats, struct rng *rng,
+                   puzzle puz, int max_remove) {
     int indices[BOARD_LENGTH];
-    int possibilities[INK_END];
-    _random_indices(indices, 0, BOARD_LENGTH);
+    struct removal r;
+    _random_indices(rng, indices, 0, BOARD_LENGTH);
+    assert(max_remove <= BOARD_LENGTH);
+    _removal_init(&r, puz);
+    for (int i = 0; i < max_remove; i++) {
+        int x = indices[i] % GROUP_LENGTH;
+        int y = indices[i] / GROUP_LENGTH;
+        if (_removal_unique(ws, stats, &r, puz, x, y)) {
+            _removal_commit(&r, puz, x, y);
+        }
+    }
+}
 
-    /* clear board, allow all possibilities */
-    puzzle_init(blank);
-    /* fill each of the 81 cell in turn, filling with a random possibilty
-     * after each fill, check that a solution still exists */
+/* rate a puzzle as puzzle_rate, adding the rating's counters to stats, if
+ * not NULL; they are only kept in a workspace the caller gives */
+int _rate_counted(puzzle puz, struct rating *r, struct workspace *ws,
+                  struct stats *stats) {
+    if (!puzzle_rate(puz, r, ws)) {
+        return 0;
+    }
+    if (stats && ws) {
+        stats_add(stats, &ws->stats);
+    }
+    return 1;
+}
+
+/* as _remove_cells, but steering towards a grade: each removal which keeps
+ * the solution unique is rated before it is kept, and one which would take
+ * the puzzle past hi is passed over, leaving the clue in place. removing
+ * clues mostly makes a puzzle harder, so this climbs as close to hi as the
+ * grid allows, instead of making a minimal puzzle and hoping it lands in
+ * the band. leaves the final rating in rating, and returns 1, or 0 if a
+ * rating could not get a workspace */
+int _remove_cells_graded(struct workspace *ws, struct stats *stats,
+                         struct rng *rng, puzzle puz, double hi,
+                         struct rating *rating) {
+    int indices[BOARD_LENGTH];
+    struct removal r;
+    _random_indices(rng, indices, 0, BOARD_LENGTH);
+    _removal_init(&r, puz);
+    if (!_rate_counted(puz, rating, ws, stats)) {
+        return 0;
+    }
     for (int i = 0; i < BOARD_LENGTH; i++) {
         int x = indices[i] % GROUP_LENGTH;
         int y = indices[i] / GROUP_LENGTH;
-        _random_indices(possibilities, INK_START, INK_END + 1);
-        assert(!blank[x][y].complete);
-        for (int n = 0; n <= INK_END - INK_START; n++) {
-            int p = possibilities[n];
-            if (blank[x][y].u.pencil & ink_to_pencil(p)) {
-                puzzle_copy(blank, copy);
-                puzzle_fill_cell(copy, x, y, p);
-                /* check to make sure the puzzle is still solvable */
-                if (puzzle_backtrack(copy)) {
-                    /* then fill the actual copy of the puzzle with that number */
-                    puzzle_fill_cell(blank, x, y, p);
+        if (!_removal_unique(ws, stats, &r, puz, x, y)) {
+            continue;
+        }
+        struct removal trial_r = r;
+        struct rating trial_rating;
+        puzzle trial;
+        puzzle_copy(puz, trial);
+        _removal_commit(&trial_r, trial, x, y);
+        if (!_rate_counted(trial, &trial_rating, ws, stats)) {
+            return 0;
+        }
+        if (trial_rating.grade <= hi) {
+            r = trial_r;
+            puzzle_copy(trial, puz);
+            *rating = trial_rating;
+        }
+    }
+    return 1;
+}
+
+/* the parallel version of _remove_cells makes the same decisions, in the
+ * same order, but checks a window of the upcoming cells at once, each
+ * against the puzzle as it stood when the window started. the results are
+ * then taken in order. one which says the clue must stay is still good
+ * however many of the earlier cells in the window were removed, since
+ * removing clues only ever adds solutions; one which says the clue can go
+ * is only good if nothing before it in the window was removed, so the
+ * first such stale result ends the window, and the next window starts
+ * with it. as the puzzle thins out most clues have to stay, so windows get
+ * longer just when the checks get expensive */
+struct removal_check {
+    struct workspace **spaces;
+    int counted; /* whether to count in the workspace's stats */
+    const struct removal *r;
+    struct cell (*puz)[GROUP_LENGTH];
+    int x;
+    int y;
+    int unique;
+};
+
+void _removal_check_task(void *arg, int worker) {
+    struct removal_check *c = arg;
+    struct workspace *ws = c->spaces ? c->spaces[worker] : NULL;
+    c->unique = _removal_unique(ws, c->counted ? &ws->stats : NULL, c->r,
+                                c->puz, c->x, c->y);
+}
+
+void _remove_cells_parallel(struct rng *rng, puzzle puz, int max_remove,
+                            struct pool *pool, struct workspace **spaces,
+                            struct stats *stats) {
+    int indices[BOARD_LENGTH];
+    struct removal_check checks[BOARD_LENGTH];
+    struct removal r;
+    int window = pool->nworkers * 2;
+    _random_indices(rng, indices, 0, BOARD_LENGTH);
+    assert(max_remove <= BOARD_LENGTH);
+    _removal_init(&r, puz);
+    /* each worker counts in its own workspace, and the counts are gathered
+     * once the workers are done; without workspaces nothing is counted */
+    int counted = stats && spaces;
+    for (int w = 0; counted && w < pool->nworkers; w++) {
+        stats_reset(&spaces[w]->stats);
+    }
+    int i = 0;
+    while (i < max_remove) {
+        /* forced cells need no search, so there is nothing to gain by
+         * farming them out */
+        while (i < max_remove &&
+               _removal_forced(&r, puz, indices[i] % GROUP_LENGTH,
+                               indices[i] / GROUP_LENGTH)) {
+            _removal_commit(&r, puz, indices[i] % GROUP_LENGTH,
+                            indices[i] / GROUP_LENGTH);
+            i++;
+        }
+        int n = 0;
+        for (int j = i; j < max_remove && n < window; j++, n++) {
+            struct removal_check *c = &checks[n];
+            c->spaces = spaces;
+            c->counted = counted;
+            c->r = &r;
+            c->puz = puz;
+            c->x = indices[j] % GROUP_LENGTH;
+            c->y = indices[j] / GROUP_LENGTH;
+            pool_submit(pool, _removal_check_task, c);
+        }
+        pool_wait(pool);
+        int removed = 0;
+        int k;
+        for (k = 0; k < n; k++) {
+            if (checks[k].unique) {
+                if (removed) {
                     break;
                 }
+                _removal_commit(&r, puz, checks[k].x, checks[k].y);
+                removed = 1;
             }
         }
-        // TODO: this assertion seems like it should fail sometimes
-        assert(blank[x][y].complete);
-        assert(puzzle_noninked_count(blank) == BOARD_LENGTH - i - 1);
+        i += k;
+    }
+    for (int w = 0; counted && w < pool->nworkers; w++) {
+        stats_add(stats, &spaces[w]->stats);
     }
 }
 
-void _remove_cells(puzzle puz, int max_remove) {
-    int indices[BOARD_LENGTH];
-    puzzle copy;
-    _random_indices(indices, 0, BOARD_LENGTH);
-    assert(max_remove <= BOARD_LENGTH);
-    for (int i = 0; i < max_remove; i++) {
-        int x = indices[i] % GROUP_LENGTH;
-        int y = indices[i] / GROUP_LENGTH;
-        /* clear cell on copy, then solve to find the number of solutions
-         * possible. If there is still a unique solution, then wipe this
-         * cell on the actual working copy of the puzzle */
-        puzzle_copy(puz, copy);
-        puzzle_clear_cell(copy, x, y);
-        puzzle_pencil_possibilities(copy);
-        int solution_count = puzzle_solution_count(copy, 2);
-        assert(solution_count > 0);
-
-        if (solution_count == 1) {
-            puzzle_clear_cell(puz, x, y);
+/* generate a puzzle with a unique solution. the puzzle depends only on the
+ * seed, and nothing is shared between calls, so any number of threads can
+ * generate at once, given a workspace each (or NULL, for one to be made
+ * for each search). the searches' counters are added to stats, if not
+ * NULL */
+void puzzle_generate_seeded(puzzle puz, uint64_t seed, struct workspace *ws,
+                            struct stats *stats) {
+    struct rng rng;
+    rng_seed(&rng, seed);
+    _fill_puzzle(ws, stats, &rng, puz);
+    _remove_cells(ws, stats, &rng, puz, 81);
+}
+
+/* as puzzle_generate_seeded, giving the same puzzle for the same seed, but
+ * spreading the clue removal checks over the workers of a pool, to cut the
+ * time taken by a single puzzle. the pool must not be running anything
+ * else. spaces, if not NULL, holds a workspace for each worker; the
+ * calling thread borrows the first while the workers are idle. the
+ * workers only count into stats when they have workspaces */
+void puzzle_generate_parallel(puzzle puz, uint64_t seed, struct pool *pool,
+                              struct workspace **spaces, struct stats *stats) {
+    struct rng rng;
+    rng_seed(&rng, seed);
+    _fill_puzzle(spaces ? spaces[0] : NULL, stats, &rng, puz);
+    _remove_cells_parallel(&rng, puz, 81, pool, spaces, stats);
+}
+
+/* generate a puzzle whose grade (see rating.h) is between lo and hi, from
+ * the given seed. a grid which cannot be brought into the band is dropped
+ * for a fresh one, up to GRADED_ATTEMPTS times. returns 1 with the puzzle
+ * and its rating, or 0 if the band was not reached or a rating could not
+ * get a workspace. counters go to stats as for puzzle_generate_seeded,
+ * though the ratings' are only kept when ws is not NULL */
+int puzzle_generate_graded(puzzle puz, uint64_t seed, double lo, double hi,
+                           struct rating *rating, struct workspace *ws,
+                           struct stats *stats) {
+    struct rng rng;
+    rng_seed(&rng, seed);
+    for (int attempt = 0; attempt < GRADED_ATTEMPTS; attempt++) {
+        _fill_puzzle(ws, stats, &rng, puz);
+        if (!_remove_cells_graded(ws, stats, &rng, puz, hi, rating)) {
+            return 0;
+        }
+        if (rating->grade >= lo) {
+            return 1;
         }
     }
+    return 0;
 }
 
+/* generate a puzzle from a fresh seed; the seed mixes in a count of calls
+ * as well as the time, so calls made within the same second still differ */
 void puzzle_generate(puzzle puz) {
-    srand(time(NULL));
-    _fill_puzzle(puz);
-    _remove_cells(puz, 81);
+    static uint64_t calls;
+    uint64_t call = __atomic_fetch_add(&calls, 1, __ATOMIC_RELAXED);
+    puzzle_generate_seeded(puz, ((uint64_t) time(NULL) << 20) ^ call, NULL,
+                           NULL);
 }
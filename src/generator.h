@@ -1,6 +1,24 @@
 #ifndef __GENERATOR_H__
 #define __GENERATOR_H__
 
+#include <stdint.h>
+
+#include "cell.h"
+#include "rng.h"
+#include "pool.h"
+#include "rating.h"
+#include "backtrack.h"
+
+/* grids tried by puzzle_generate_graded before giving up on a band */
+#define GRADED_ATTEMPTS 16
+
 void puzzle_generate(puzzle blank);
+void puzzle_generate_seeded(puzzle blank, uint64_t seed,
+                            struct workspace *ws, struct stats *stats);
+void puzzle_generate_parallel(puzzle blank, uint64_t seed, struct pool *pool,
+                              struct workspace **spaces, struct stats *stats);
+int puzzle_generate_graded(puzzle blank, uint64_t seed, double lo, double hi,
+                           struct rating *rating, struct workspace *ws,
+                           struct stats *stats);
 
 #endif
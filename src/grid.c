@@ -0,0 +1,97 @@
+#include <assert.h>
+#include <string.h>
+
+#include "grid.h"
+#include "constants.h"
+
+int _grid_digit(char c) {
+    if (c == '.' || c == '0') {
+        return 0;
+    } else if (c >= '1' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'A' && c <= 'Z') {
+        return c - 'A' + 10;
+    } else if (c >= 'a' && c <= 'z') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+/* parse a grid in single line format, taking its size from the length of
+ * the line up to the first blank, so that anything after a blank (a count
+ * of solutions, say) is ignored. returns 0 if the line is not a grid of a
+ * supported size */
+int grid_parse_line(struct grid *g, const char *line) {
+    size_t len = strcspn(line, " \t\r\n");
+    g->box = 0;
+    for (int box = DLX_BOX_MIN; box <= DLX_BOX_MAX; box++) {
+        if (len == (size_t) box * box * box * box) {
+            g->box = box;
+        }
+    }
+    if (!g->box) {
+        return 0;
+    }
+    g->side = g->box * g->box;
+    for (int i = 0; i < g->side * g->side; i++) {
+        int d = _grid_digit(line[i]);
+        if (d < 0 || d > g->side) {
+            return 0;
+        }
+        g->cells[i] = d;
+    }
+    return 1;
+}
+
+/* read the next grid in single line format, skipping empty lines and lines
+ * starting with '#'. returns as puzzle_read_line does */
+int grid_read_line(struct grid *g, FILE *f) {
+    char line[GRID_CELLS_MAX + 8];
+    while (fgets(line, sizeof(line), f)) {
+        size_t len = strlen(line);
+        if (len == sizeof(line) - 1 && line[len - 1] != '\n') {
+            /* overlong line, discard the rest of it */
+            int c;
+            while ((c = getc(f)) != EOF && c != '\n');
+            return INCONSISTENT;
+        }
+        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') {
+            continue;
+        }
+        return grid_parse_line(g, line) ? 1 : INCONSISTENT;
+    }
+    return 0;
+}
+
+/* copy a 9x9 grid into a puzzle, with every blank cell's pencil marks
+ * left open */
+void grid_to_puzzle(const struct grid *g, puzzle puz) {
+    assert(g->box == 3);
+    for (int i = 0; i < BOARD_LENGTH; i++) {
+        struct cell *c = &puz[i % GROUP_LENGTH][i / GROUP_LENGTH];
+        c->complete = g->cells[i] != 0;
+        if (c->complete) {
+            c->u.ink = g->cells[i];
+        } else {
+            c->u.pencil = ALL_POS;
+        }
+    }
+}
+
+/* write side * side characters, with no terminator */
+void grid_to_line(const struct grid *g, char *line) {
+    for (int i = 0; i < g->side * g->side; i++) {
+        int d = g->cells[i];
+        line[i] = d == 0 ? '.' : d <= 9 ? '0' + d : 'A' + d - 10;
+    }
+}
+
+/* count the solutions of a grid, stopping once max have been found, and
+ * leaving the first one found in the grid. the matrix goes in arenas, if
+ * not NULL (see dlx_search_sized). returns -1 if out of memory */
+int grid_search(struct grid *g, int max, struct stats *stats,
+                struct dlx_arenas *arenas) {
+    uint64_t count = dlx_search_sized(g->box, g->cells, max, stats, arenas,
+                                      NULL);
+    return count == DLX_NO_MEMORY ? -1 : (int) count;
+}
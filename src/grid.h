@@ -0,0 +1,35 @@
+#ifndef __GRID_H__
+#define __GRID_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "cell.h"
+#include "dlx.h"
+#include "stats.h"
+
+/* a board of any supported size: boxes of box x box cells, so side x side
+ * cells and digits from 1 to side. the fixed 9x9 puzzle type is what the
+ * logic solver works on; grids are solved with the dancing links engine,
+ * which handles every size.
+ *
+ * in single line format a grid is side * side characters in row major
+ * order, '.' or '0' for a blank, and digits above 9 written as letters
+ * from 'A' (so 16x16 uses 1-9 and A-G), which the size is told from */
+#define GRID_SIDE_MAX (DLX_BOX_MAX * DLX_BOX_MAX)
+#define GRID_CELLS_MAX (GRID_SIDE_MAX * GRID_SIDE_MAX)
+
+struct grid {
+    int box;
+    int side;
+    uint8_t cells[GRID_CELLS_MAX]; /* row major, 0 for blank */
+};
+
+int grid_parse_line(struct grid *g, const char *line);
+int grid_read_line(struct grid *g, FILE *f);
+void grid_to_line(const struct grid *g, char *line);
+void grid_to_puzzle(const struct grid *g, puzzle puz);
+int grid_search(struct grid *g, int max_solutions, struct stats *stats,
+                struct dlx_arenas *arenas);
+
+#endif
@@ -0,0 +1,125 @@
+#include <string.h>
+
+#include "hidden.h"
+#include "constants.h"
+
+const char *hidden_kernel_names[] = {
+    "auto", "bitboard", "scalar", "sse4.1", "avx2", NULL
+};
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HIDDEN_X86 1
+#else
+#define HIDDEN_X86 0
+#endif
+
+typedef void (*hidden_fn)(const uint16_t lanes[GROUP_LENGTH][LANE_UNITS],
+                          uint16_t once[LANE_UNITS],
+                          uint16_t twice[LANE_UNITS]);
+
+/* for each unit, a digit seen in a cell after it has already been seen is
+ * seen twice; so walking the positions of the units in step, twice picks
+ * up once & lane before once picks up the lane itself */
+void _hidden_scalar(const uint16_t lanes[GROUP_LENGTH][LANE_UNITS],
+                    uint16_t once[LANE_UNITS], uint16_t twice[LANE_UNITS]) {
+    for (int u = 0; u < LANE_UNITS; u++) {
+        uint16_t o = 0;
+        uint16_t t = 0;
+        for (int p = 0; p < GROUP_LENGTH; p++) {
+            t |= o & lanes[p][u];
+            o |= lanes[p][u];
+        }
+        once[u] = o;
+        twice[u] = t;
+    }
+}
+
+#if HIDDEN_X86
+typedef uint16_t v8u16 __attribute__((vector_size(16)));
+typedef uint16_t v16u16 __attribute__((vector_size(32)));
+
+/* the vector kernels do the same as the scalar one, 8 or 16 units per
+ * register. memcpy keeps the loads unaligned, so boards need no special
+ * alignment */
+__attribute__((target("sse4.1")))
+void _hidden_sse41(const uint16_t lanes[GROUP_LENGTH][LANE_UNITS],
+                   uint16_t once[LANE_UNITS], uint16_t twice[LANE_UNITS]) {
+    for (int u = 0; u < LANE_UNITS; u += 8) {
+        v8u16 o = { 0 };
+        v8u16 t = { 0 };
+        for (int p = 0; p < GROUP_LENGTH; p++) {
+            v8u16 v;
+            memcpy(&v, &lanes[p][u], sizeof v);
+            t |= o & v;
+            o |= v;
+        }
+        memcpy(&once[u], &o, sizeof o);
+        memcpy(&twice[u], &t, sizeof t);
+    }
+}
+
+__attribute__((target("avx2")))
+void _hidden_avx2(const uint16_t lanes[GROUP_LENGTH][LANE_UNITS],
+                  uint16_t once[LANE_UNITS], uint16_t twice[LANE_UNITS]) {
+    for (int u = 0; u < LANE_UNITS; u += 16) {
+        v16u16 o = { 0 };
+        v16u16 t = { 0 };
+        for (int p = 0; p < GROUP_LENGTH; p++) {
+            v16u16 v;
+            memcpy(&v, &lanes[p][u], sizeof v);
+            t |= o & v;
+            o |= v;
+        }
+        memcpy(&once[u], &o, sizeof o);
+        memcpy(&twice[u], &t, sizeof t);
+    }
+}
+#endif
+
+enum hidden_kernel hidden_kernel = HIDDEN_AUTO;
+hidden_fn _hidden_fn = _hidden_scalar;
+
+/* switch the kernel used by the singleton number strategy. this is global,
+ * so it should be done before any solving starts. returns the kernel
+ * actually chosen, which falls back to the scalar kernel if the cpu does
+ * not support the one asked for */
+enum hidden_kernel hidden_select(enum hidden_kernel k) {
+    int avx2 = 0;
+    int sse41 = 0;
+#if HIDDEN_X86
+    __builtin_cpu_init();
+    avx2 = __builtin_cpu_supports("avx2");
+    sse41 = __builtin_cpu_supports("sse4.1");
+#endif
+    if (k == HIDDEN_AUTO) {
+        k = avx2 ? HIDDEN_AVX2 : sse41 ? HIDDEN_SSE41 : HIDDEN_BITBOARD;
+    }
+    if ((k == HIDDEN_AVX2 && !avx2) || (k == HIDDEN_SSE41 && !sse41)) {
+        k = HIDDEN_SCALAR;
+    }
+    _hidden_fn = _hidden_scalar;
+#if HIDDEN_X86
+    if (k == HIDDEN_AVX2) {
+        _hidden_fn = _hidden_avx2;
+    } else if (k == HIDDEN_SSE41) {
+        _hidden_fn = _hidden_sse41;
+    }
+#endif
+    hidden_kernel = k;
+    return k;
+}
+
+/* returns -1 for an unknown name */
+int hidden_kernel_by_name(const char *name) {
+    for (int i = 0; hidden_kernel_names[i]; i++) {
+        if (strcmp(name, hidden_kernel_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void hidden_scan(const uint16_t lanes[GROUP_LENGTH][LANE_UNITS],
+                 uint16_t once[LANE_UNITS], uint16_t twice[LANE_UNITS]) {
+    _hidden_fn(lanes, once, twice);
+}
@@ -0,0 +1,30 @@
+#ifndef __HIDDEN_H__
+#define __HIDDEN_H__
+
+#include <stdint.h>
+
+#include "board.h"
+
+/* kernels for finding hidden singles. HIDDEN_BITBOARD counts each unplaced
+ * digit's places in each dirty unit with the per digit bitboards; the rest
+ * sweep the board's lanes, computing for all 27 units at once which digits
+ * are seen in exactly one cell and which are seen in more than one.
+ * HIDDEN_AUTO picks the fastest the cpu supports, and is resolved the
+ * first time a board is loaded if nothing has been selected before then */
+enum hidden_kernel {
+    HIDDEN_AUTO,
+    HIDDEN_BITBOARD,
+    HIDDEN_SCALAR,
+    HIDDEN_SSE41,
+    HIDDEN_AVX2
+};
+
+extern const char *hidden_kernel_names[];
+extern enum hidden_kernel hidden_kernel;
+
+enum hidden_kernel hidden_select(enum hidden_kernel k);
+int hidden_kernel_by_name(const char *name);
+void hidden_scan(const uint16_t lanes[GROUP_LENGTH][LANE_UNITS],
+                 uint16_t once[LANE_UNITS], uint16_t twice[LANE_UNITS]);
+
+#endif
@@ -0,0 +1,259 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/* a load generator for serve mode (see serve.h). it keeps a fixed number
+ * of requests in flight on one connection, cycling through the grids of a
+ * corpus (or through seeds, for generate), and reports the sustained rate
+ * and the latency seen by the client, alongside the server's own figures */
+
+#define LOADGEN_LINE_MAX 1024
+
+struct loadgen {
+    int fd;
+    const char *op; /* the request, up to the grid */
+    char **grids;
+    int ngrids;
+    long requests;
+    int inflight_max;
+    struct timespec *sent; /* by request id */
+    double *latency; /* client side, in microseconds; 0 if unanswered */
+    long server_micros;
+    long nodes;
+    long errors;
+    int inflight;
+    int done; /* the server has hung up, so no more space will be made */
+    pthread_mutex_t lock;
+    pthread_cond_t space;
+};
+
+double _loadgen_micros(const struct timespec *a, const struct timespec *b) {
+    return (b->tv_sec - a->tv_sec) * 1e6 + (b->tv_nsec - a->tv_nsec) / 1e3;
+}
+
+void *_loadgen_send(void *arg) {
+    struct loadgen *g = arg;
+    FILE *out = fdopen(dup(g->fd), "w");
+    if (!out) {
+        return NULL;
+    }
+    for (long i = 0; i < g->requests; i++) {
+        pthread_mutex_lock(&g->lock);
+        while (g->inflight >= g->inflight_max && !g->done) {
+            /* nothing more will be sent for a while, so push out what there
+             * is; the lock is dropped so the reader can make space */
+            pthread_mutex_unlock(&g->lock);
+            fflush(out);
+            pthread_mutex_lock(&g->lock);
+            if (g->inflight >= g->inflight_max && !g->done) {
+                pthread_cond_wait(&g->space, &g->lock);
+            }
+        }
+        if (g->done) {
+            pthread_mutex_unlock(&g->lock);
+            break;
+        }
+        g->inflight++;
+        clock_gettime(CLOCK_MONOTONIC, &g->sent[i]);
+        pthread_mutex_unlock(&g->lock);
+        if (g->ngrids) {
+            fprintf(out, "%ld %s %s\n", i, g->op, g->grids[i % g->ngrids]);
+        } else {
+            fprintf(out, "%ld %s %ld\n", i, g->op, i);
+        }
+    }
+    fflush(out);
+    /* tell the server there is nothing more to come */
+    shutdown(fileno(out), SHUT_WR);
+    fclose(out);
+    return NULL;
+}
+
+void _loadgen_receive(struct loadgen *g) {
+    FILE *in = fdopen(g->fd, "r");
+    char line[LOADGEN_LINE_MAX];
+    for (long got = 0; in && got < g->requests &&
+                       fgets(line, sizeof line, in); got++) {
+        struct timespec now;
+        char status[16];
+        long id;
+        long micros;
+        long nodes;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        /* every line answers a request, so it makes space even when it
+         * cannot be told which */
+        int parsed = sscanf(line, "%ld %15s %ld %ld", &id, status, &micros,
+                            &nodes) == 4 && id >= 0 && id < g->requests;
+        pthread_mutex_lock(&g->lock);
+        if (parsed) {
+            g->latency[id] = _loadgen_micros(&g->sent[id], &now);
+        }
+        g->inflight--;
+        pthread_cond_signal(&g->space);
+        pthread_mutex_unlock(&g->lock);
+        if (!parsed || strcmp(status, "ok") != 0) {
+            g->errors++;
+        }
+        if (parsed) {
+            g->server_micros += micros;
+            g->nodes += nodes;
+        }
+    }
+    if (in) {
+        fclose(in);
+    }
+    /* the server has answered everything or hung up: either way, a sender
+     * still waiting for space would wait for ever */
+    pthread_mutex_lock(&g->lock);
+    g->done = 1;
+    pthread_cond_broadcast(&g->space);
+    pthread_mutex_unlock(&g->lock);
+}
+
+int _loadgen_cmp(const void *a, const void *b) {
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/* read the grids of a corpus, one per line, skipping blank lines and
+ * comments */
+int _loadgen_load(struct loadgen *g, const char *path) {
+    FILE *f = fopen(path, "r");
+    char line[LOADGEN_LINE_MAX];
+    int cap = 0;
+    int ok = 1;
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+    while (ok && fgets(line, sizeof line, f)) {
+        line[strcspn(line, " \t\r\n")] = '\0';
+        if (!line[0] || line[0] == '#') {
+            continue;
+        }
+        if (g->ngrids == cap) {
+            int more = cap ? cap * 2 : 1024;
+            char **grids = realloc(g->grids, more * sizeof *g->grids);
+            if (!grids) {
+                ok = 0;
+                break;
+            }
+            g->grids = grids;
+            cap = more;
+        }
+        if (!(g->grids[g->ngrids] = strdup(line))) {
+            ok = 0;
+            break;
+        }
+        g->ngrids++;
+    }
+    fclose(f);
+    if (!ok) {
+        fprintf(stderr, "%s: out of memory\n", path);
+    }
+    return ok && g->ngrids > 0;
+}
+
+void _loadgen_usage(void) {
+    puts("Usage: ./sudoku-loadgen --socket PATH [--op OP] [--requests N]\n"
+         "                        [--inflight N] [corpus]\n"
+         "ops: solve unique \"count N\" rate generate (default: solve)\n"
+         "a corpus is needed for every op but generate");
+}
+
+int main(int argc, char *argv[]) {
+    struct loadgen g;
+    const char *path = NULL;
+    const char *corpus = NULL;
+    memset(&g, 0, sizeof g);
+    g.op = "solve";
+    g.requests = 10000;
+    g.inflight_max = 64;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            path = argv[++i];
+        } else if (strcmp(argv[i], "--op") == 0 && i + 1 < argc) {
+            g.op = argv[++i];
+        } else if (strcmp(argv[i], "--requests") == 0 && i + 1 < argc) {
+            g.requests = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--inflight") == 0 && i + 1 < argc) {
+            g.inflight_max = atoi(argv[++i]);
+        } else if (!corpus) {
+            corpus = argv[i];
+        } else {
+            _loadgen_usage();
+            return 1;
+        }
+    }
+    int generate = strcmp(g.op, "generate") == 0;
+    if (!path || g.requests < 1 || g.inflight_max < 1 ||
+        (!generate && !corpus)) {
+        _loadgen_usage();
+        return 1;
+    }
+    if (!generate && !_loadgen_load(&g, corpus)) {
+        return 1;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof addr.sun_path - 1);
+    g.fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (g.fd < 0 || connect(g.fd, (struct sockaddr *) &addr, sizeof addr)) {
+        perror(path);
+        return 1;
+    }
+    /* a server which hangs up shows as unanswered requests, not a signal */
+    signal(SIGPIPE, SIG_IGN);
+    g.sent = calloc(g.requests, sizeof *g.sent);
+    g.latency = calloc(g.requests, sizeof *g.latency);
+    if (!g.sent || !g.latency) {
+        return 1;
+    }
+    pthread_mutex_init(&g.lock, NULL);
+    pthread_cond_init(&g.space, NULL);
+
+    struct timespec start;
+    struct timespec end;
+    pthread_t sender;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int err = pthread_create(&sender, NULL, _loadgen_send, &g);
+    if (err) {
+        fprintf(stderr, "cannot start the sender: %s\n", strerror(err));
+        return 1;
+    }
+    _loadgen_receive(&g);
+    pthread_join(sender, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double secs = _loadgen_micros(&start, &end) / 1e6;
+    /* the percentiles are of the requests which were answered */
+    long n = 0;
+    for (long i = 0; i < g.requests; i++) {
+        if (g.latency[i] > 0) {
+            g.latency[n++] = g.latency[i];
+        }
+    }
+    qsort(g.latency, n, sizeof *g.latency, _loadgen_cmp);
+    printf("%ld requests (%ld errors, %ld unanswered) in %.3f s, "
+           "%.0f requests/s, %d in flight\n", g.requests, g.errors,
+           g.requests - n, secs, secs > 0 ? n / secs : 0.0, g.inflight_max);
+    if (n) {
+        printf("client latency (us): p50 %.1f  p99 %.1f  p99.9 %.1f  "
+               "max %.1f\n", g.latency[n / 2], g.latency[n * 99 / 100],
+               g.latency[n * 999 / 1000], g.latency[n - 1]);
+        printf("server: %.1f us held, %.2f nodes per request\n",
+               (double) g.server_micros / n, (double) g.nodes / n);
+    }
+    return g.errors || n < g.requests ? 1 : 0;
+}
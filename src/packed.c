@@ -0,0 +1,101 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "packed.h"
+
+static const uint8_t _packed_magic[4] = { 0x89, 'P', 'S', 'K' };
+
+void packed_encode(const uint8_t *cells, uint8_t *record) {
+    memset(record, 0, PACKED_RECORD);
+    for (int i = 0; i < BOARD_LENGTH; i++) {
+        record[i / 2] |= cells[i] << (i % 2 * 4);
+    }
+}
+
+/* returns 0 if some nibble is not a digit */
+int packed_decode(const uint8_t *record, uint8_t *cells) {
+    int ok = 1;
+    for (int i = 0; i < BOARD_LENGTH; i += 2) {
+        cells[i] = record[i / 2] & 0xf;
+        ok &= cells[i] <= GROUP_LENGTH;
+        if (i + 1 < BOARD_LENGTH) {
+            cells[i + 1] = record[i / 2] >> 4;
+            ok &= cells[i + 1] <= GROUP_LENGTH;
+        }
+    }
+    return ok;
+}
+
+/* fill in a header for count records (0 if not known) */
+void packed_header(uint8_t *header, uint64_t count) {
+    memcpy(header, _packed_magic, sizeof _packed_magic);
+    header[4] = PACKED_VERSION;
+    header[5] = 3;
+    header[6] = PACKED_RECORD & 0xff;
+    header[7] = PACKED_RECORD >> 8;
+    for (int i = 0; i < 8; i++) {
+        header[8 + i] = count >> (8 * i);
+    }
+}
+
+/* whether path is a regular file which starts with the magic, and so is
+ * meant as a packed corpus, whether or not the rest of it is sound */
+int packed_sniff(const char *path) {
+    struct stat st;
+    uint8_t magic[sizeof _packed_magic];
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    int is = fstat(fd, &st) == 0 && S_ISREG(st.st_mode) &&
+             read(fd, magic, sizeof magic) == (ssize_t) sizeof magic &&
+             memcmp(magic, _packed_magic, sizeof magic) == 0;
+    close(fd);
+    return is;
+}
+
+/* map a packed corpus. returns 0 if the file cannot be opened, or is not a
+ * packed corpus this version can read */
+int packed_open(struct packed *p, const char *path) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    if (fstat(fd, &st) < 0 || st.st_size < PACKED_HEADER) {
+        close(fd);
+        return 0;
+    }
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return 0;
+    }
+    const uint8_t *h = base;
+    uint64_t count = 0;
+    for (int i = 0; i < 8; i++) {
+        count |= (uint64_t) h[8 + i] << (8 * i);
+    }
+    uint64_t fits = (st.st_size - PACKED_HEADER) / PACKED_RECORD;
+    if (memcmp(h, _packed_magic, sizeof _packed_magic) != 0 ||
+        h[4] != PACKED_VERSION || h[5] != 3 ||
+        (h[6] | h[7] << 8) != PACKED_RECORD || count > fits) {
+        munmap(base, st.st_size);
+        return 0;
+    }
+    posix_madvise(base, st.st_size, POSIX_MADV_SEQUENTIAL);
+    p->base = base;
+    p->size = st.st_size;
+    p->count = count ? count : fits;
+    p->records = h + PACKED_HEADER;
+    return 1;
+}
+
+void packed_close(struct packed *p) {
+    munmap((void *) p->base, p->size);
+}
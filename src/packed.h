@@ -0,0 +1,49 @@
+#ifndef __PACKED_H__
+#define __PACKED_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "constants.h"
+
+/* the packed corpus format, for 9x9 puzzles: a header of PACKED_HEADER
+ * bytes, then one record of PACKED_RECORD bytes per puzzle. a record holds
+ * the 81 cells in row major order, one per 4 bit nibble (0 for a blank),
+ * cell i in the low nibble of byte i / 2 when i is even and the high
+ * nibble when it is odd. the records are all the same size, so a record's
+ * offset is its index; there is no separate index to keep.
+ *
+ * the header is:
+ *   0  4 bytes  magic, "\x89PSK" (not text, so never taken for a puzzle)
+ *   4  1 byte   version, 1
+ *   5  1 byte   box side, 3
+ *   6  2 bytes  record size, little endian
+ *   8  8 bytes  number of records, little endian, or 0 if the writer could
+ *               not go back and fill it in, in which case it is taken from
+ *               the size of the file */
+#define PACKED_HEADER 16
+#define PACKED_RECORD ((BOARD_LENGTH + 1) / 2)
+#define PACKED_VERSION 1
+
+/* a packed corpus mapped into memory. records point straight into the
+ * mapping, so they can be handed to any number of threads without copying */
+struct packed {
+    const uint8_t *base;
+    size_t size;
+    uint64_t count;
+    const uint8_t *records;
+};
+
+void packed_encode(const uint8_t *cells, uint8_t *record);
+int packed_decode(const uint8_t *record, uint8_t *cells);
+void packed_header(uint8_t *header, uint64_t count);
+int packed_sniff(const char *path);
+int packed_open(struct packed *p, const char *path);
+void packed_close(struct packed *p);
+
+static inline const uint8_t *packed_record(const struct packed *p,
+                                           uint64_t i) {
+    return p->records + i * PACKED_RECORD;
+}
+
+#endif
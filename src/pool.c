@@ -0,0 +1,211 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include "pool.h"
+
+#define DEQUE_INITIAL 64
+
+int pool_cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? n : 1;
+}
+
+void _deque_push(struct deque *d, struct task t) {
+    pthread_mutex_lock(&d->lock);
+    if (d->len == d->cap) {
+        /* grow, unrolling the ring so head is at the start again */
+        int cap = d->cap ? d->cap * 2 : DEQUE_INITIAL;
+        struct task *tasks = malloc(cap * sizeof *tasks);
+        assert(tasks);
+        for (int i = 0; i < d->len; i++) {
+            tasks[i] = d->tasks[(d->head + i) % d->cap];
+        }
+        free(d->tasks);
+        d->tasks = tasks;
+        d->cap = cap;
+        d->head = 0;
+    }
+    d->tasks[(d->head + d->len) % d->cap] = t;
+    d->len++;
+    pthread_mutex_unlock(&d->lock);
+}
+
+/* the owner of a deque takes from the front, so that tasks are run roughly
+ * in submission order */
+int _deque_pop_front(struct deque *d, struct task *t) {
+    int found = 0;
+    pthread_mutex_lock(&d->lock);
+    if (d->len) {
+        *t = d->tasks[d->head];
+        d->head = (d->head + 1) % d->cap;
+        d->len--;
+        found = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return found;
+}
+
+/* thieves take from the back, away from where the owner is working */
+int _deque_pop_back(struct deque *d, struct task *t) {
+    int found = 0;
+    pthread_mutex_lock(&d->lock);
+    if (d->len) {
+        d->len--;
+        *t = d->tasks[(d->head + d->len) % d->cap];
+        found = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return found;
+}
+
+int _pool_take(struct pool *p, int index, struct task *t) {
+    if (_deque_pop_front(&p->workers[index].queue, t)) {
+        return 1;
+    }
+    for (int k = 1; k < p->nworkers; k++) {
+        if (_deque_pop_back(&p->workers[(index + k) % p->nworkers].queue, t)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void *_pool_worker(void *arg) {
+    struct worker *w = arg;
+    struct pool *p = w->pool;
+    struct task t;
+    while (1) {
+        if (_pool_take(p, w->index, &t)) {
+            __atomic_sub_fetch(&p->pending, 1, __ATOMIC_SEQ_CST);
+            t.run(t.arg, w->index);
+            if (__atomic_sub_fetch(&p->active, 1, __ATOMIC_SEQ_CST) == 0) {
+                pthread_mutex_lock(&p->lock);
+                pthread_cond_broadcast(&p->done);
+                pthread_mutex_unlock(&p->lock);
+            }
+            continue;
+        }
+        /* nothing to run or steal, so sleep until something is submitted.
+         * sleeping is raised before pending is checked, and submitters raise
+         * pending before checking sleeping, so a wakeup can never be lost */
+        pthread_mutex_lock(&p->lock);
+        __atomic_add_fetch(&p->sleeping, 1, __ATOMIC_SEQ_CST);
+        while (!__atomic_load_n(&p->pending, __ATOMIC_SEQ_CST) &&
+               !p->shutdown) {
+            pthread_cond_wait(&p->wake, &p->lock);
+        }
+        __atomic_sub_fetch(&p->sleeping, 1, __ATOMIC_SEQ_CST);
+        int stop = p->shutdown &&
+                   !__atomic_load_n(&p->pending, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&p->lock);
+        if (stop) {
+            return NULL;
+        }
+    }
+}
+
+int pool_init(struct pool *p, int nworkers) {
+    assert(nworkers > 0);
+    p->nworkers = nworkers;
+    p->pending = 0;
+    p->active = 0;
+    p->sleeping = 0;
+    p->shutdown = 0;
+    p->next = 0;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->wake, NULL);
+    pthread_cond_init(&p->done, NULL);
+    p->workers = calloc(nworkers, sizeof *p->workers);
+    if (p->workers) {
+        for (int i = 0; i < nworkers; i++) {
+            struct worker *w = &p->workers[i];
+            w->pool = p;
+            w->index = i;
+            pthread_mutex_init(&w->queue.lock, NULL);
+        }
+        for (int i = 0; i < nworkers; i++) {
+            struct worker *w = &p->workers[i];
+            if (pthread_create(&w->thread, NULL, _pool_worker, w)) {
+                /* run with however many threads we managed to start */
+                p->nworkers = i;
+                break;
+            }
+        }
+        for (int i = p->nworkers; i < nworkers; i++) {
+            pthread_mutex_destroy(&p->workers[i].queue.lock);
+        }
+        if (p->nworkers > 0) {
+            return 1;
+        }
+        free(p->workers);
+    }
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->wake);
+    pthread_cond_destroy(&p->done);
+    return 0;
+}
+
+void _pool_push(struct pool *p, int worker, task_fn run, void *arg) {
+    struct task t;
+    t.run = run;
+    t.arg = arg;
+    __atomic_add_fetch(&p->active, 1, __ATOMIC_SEQ_CST);
+    _deque_push(&p->workers[worker].queue, t);
+    __atomic_add_fetch(&p->pending, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&p->sleeping, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&p->lock);
+        pthread_cond_signal(&p->wake);
+        pthread_mutex_unlock(&p->lock);
+    }
+}
+
+void pool_submit(struct pool *p, task_fn run, void *arg) {
+    unsigned next = __atomic_fetch_add(&p->next, 1, __ATOMIC_RELAXED);
+    _pool_push(p, next % p->nworkers, run, arg);
+}
+
+/* queue a task on a given worker's own deque; used by tasks which split
+ * their work, so the new pieces stay local unless they are stolen */
+void pool_submit_local(struct pool *p, int worker, task_fn run, void *arg) {
+    _pool_push(p, worker, run, arg);
+}
+
+/* whether more workers are asleep than there are queued tasks to wake
+ * them, so that a task which can split its work should. a woken worker
+ * stays counted as asleep until it has taken its task, but the task stays
+ * counted as queued until then too, so the two cancel out */
+int pool_starved(struct pool *p) {
+    return __atomic_load_n(&p->sleeping, __ATOMIC_RELAXED) >
+           __atomic_load_n(&p->pending, __ATOMIC_RELAXED);
+}
+
+/* block until every task submitted so far has finished */
+void pool_wait(struct pool *p) {
+    pthread_mutex_lock(&p->lock);
+    while (__atomic_load_n(&p->active, __ATOMIC_SEQ_CST)) {
+        pthread_cond_wait(&p->done, &p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+}
+
+void pool_destroy(struct pool *p) {
+    pool_wait(p);
+    pthread_mutex_lock(&p->lock);
+    p->shutdown = 1;
+    pthread_cond_broadcast(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+    for (int i = 0; i < p->nworkers; i++) {
+        pthread_join(p->workers[i].thread, NULL);
+    }
+    for (int i = 0; i < p->nworkers; i++) {
+        pthread_mutex_destroy(&p->workers[i].queue.lock);
+        free(p->workers[i].queue.tasks);
+    }
+    free(p->workers);
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->wake);
+    pthread_cond_destroy(&p->done);
+}
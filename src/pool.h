@@ -0,0 +1,59 @@
+#ifndef __POOL_H__
+#define __POOL_H__
+
+#include <pthread.h>
+
+/* a fixed size pool of worker threads, each of which owns a deque of tasks.
+ * tasks submitted from outside the pool are dealt out round robin; a worker
+ * runs the tasks in its own deque oldest first, and when that runs dry it
+ * steals the newest task from another worker, so a few long running tasks
+ * never leave the other workers idle behind them.
+ *
+ * tasks are passed the index of the worker running them, so callers can
+ * keep per worker state (solver scratch space, statistics, ...) in an array
+ * indexed by worker without any locking */
+
+typedef void (*task_fn)(void *arg, int worker);
+
+struct task {
+    task_fn run;
+    void *arg;
+};
+
+struct deque {
+    pthread_mutex_t lock;
+    struct task *tasks;
+    int cap;
+    int head;
+    int len;
+};
+
+struct worker {
+    pthread_t thread;
+    struct pool *pool;
+    int index;
+    struct deque queue;
+};
+
+struct pool {
+    int nworkers;
+    struct worker *workers;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    int pending; /* tasks sitting in a deque */
+    int active; /* tasks submitted, but not yet finished */
+    int sleeping;
+    int shutdown;
+    unsigned next;
+};
+
+int pool_cpu_count(void);
+int pool_init(struct pool *p, int nworkers);
+void pool_submit(struct pool *p, task_fn run, void *arg);
+void pool_submit_local(struct pool *p, int worker, task_fn run, void *arg);
+int pool_starved(struct pool *p);
+void pool_wait(struct pool *p);
+void pool_destroy(struct pool *p);
+
+#endif
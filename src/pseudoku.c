@@ -0,0 +1,509 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "pseudoku.h"
+#include "cell.h"
+#include "puzzle.h"
+#include "backtrack.h"
+#include "generator.h"
+#include "rating.h"
+#include "strategy.h"
+#include "hidden.h"
+#include "grid.h"
+#include "dlx.h"
+#include "pool.h"
+#include "stats.h"
+#include "packed.h"
+#include "count.h"
+#include "constants.h"
+
+/* the library's side of a context. the search options point at the
+ * context's counters while counting is on, at its workspace, where every
+ * search the context runs is done, and at its sink, through which every
+ * search polls the cancel flag. the pool, for generating and counting on
+ * more than one thread, is made the first time it is needed, with a
+ * workspace for each worker, and kept until the context is freed or its
+ * threads change */
+struct pseudoku {
+    struct search_opts opts;
+    struct stats stats;
+    struct workspace *space;
+    struct solutions sink;
+    int cancel;
+    int cancelled; /* whether the last search was cancelled */
+    double every; /* seconds between checkpoints, 0 for none */
+    pseudoku_checkpoint_fn checkpoint;
+    void *checkpoint_arg;
+    int threads;
+    int pool_ready;
+    struct pool pool;
+    struct workspace **spaces; /* one for each worker of the pool */
+};
+
+struct pseudoku *pseudoku_new(void) {
+    struct pseudoku *ctx = calloc(1, sizeof *ctx);
+    if (!ctx) {
+        return NULL;
+    }
+    ctx->space = workspace_new();
+    if (!ctx->space) {
+        free(ctx);
+        return NULL;
+    }
+    search_opts_init(&ctx->opts);
+    ctx->opts.space = ctx->space;
+    ctx->sink.cancel = &ctx->cancel;
+    ctx->opts.solutions = &ctx->sink;
+    stats_reset(&ctx->stats);
+    ctx->threads = 1;
+    return ctx;
+}
+
+void _pseudoku_pool_free(struct pseudoku *ctx) {
+    if (!ctx->pool_ready) {
+        return;
+    }
+    pool_destroy(&ctx->pool);
+    for (int i = 0; i < ctx->threads; i++) {
+        workspace_free(ctx->spaces[i]);
+    }
+    free(ctx->spaces);
+    ctx->spaces = NULL;
+    ctx->pool_ready = 0;
+}
+
+/* start the pool, with its workspaces. returns 0 if it could not be made,
+ * in which case the generator runs on the calling thread */
+int _pseudoku_pool_init(struct pseudoku *ctx) {
+    ctx->spaces = calloc(ctx->threads, sizeof *ctx->spaces);
+    if (!ctx->spaces) {
+        return 0;
+    }
+    for (int i = 0; i < ctx->threads; i++) {
+        if (!(ctx->spaces[i] = workspace_new())) {
+            break;
+        }
+    }
+    if (!ctx->spaces[ctx->threads - 1] ||
+        !pool_init(&ctx->pool, ctx->threads)) {
+        for (int i = 0; i < ctx->threads; i++) {
+            workspace_free(ctx->spaces[i]);
+        }
+        free(ctx->spaces);
+        ctx->spaces = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+/* whether the pool is running, starting it if the context has the threads
+ * for one */
+int _pseudoku_pool_ready(struct pseudoku *ctx) {
+    if (ctx->threads > 1 && !ctx->pool_ready) {
+        ctx->pool_ready = _pseudoku_pool_init(ctx);
+    }
+    return ctx->pool_ready;
+}
+
+void pseudoku_free(struct pseudoku *ctx) {
+    if (!ctx) {
+        return;
+    }
+    _pseudoku_pool_free(ctx);
+    workspace_free(ctx->space);
+    free(ctx);
+}
+
+/* the engine for 9x9 grids, by name (see search_engine_names) */
+int pseudoku_set_engine(struct pseudoku *ctx, const char *name) {
+    int e = search_engine_by_name(name);
+    if (e < 0) {
+        return PSEUDOKU_INVALID;
+    }
+    ctx->opts.engine = e;
+    return 0;
+}
+
+/* keep the solver's counters; off to start with, since keeping them costs
+ * a little on every strategy run */
+void pseudoku_set_stats(struct pseudoku *ctx, int on) {
+    ctx->opts.stats = on ? &ctx->stats : NULL;
+}
+
+/* spread the work for each generated puzzle, and for each full count, over
+ * this many threads, where 0 means one per online cpu */
+void pseudoku_set_threads(struct pseudoku *ctx, int threads) {
+    _pseudoku_pool_free(ctx);
+    ctx->threads = threads > 0 ? threads : pool_cpu_count();
+}
+
+/* take checkpoints of the enumerations the context runs: every so many
+ * seconds (0 for only when cancelled), fn is called with the state of the
+ * search as text of a few kilobytes, which pseudoku_resume takes up again.
+ * the state is only valid for the call, and fn returns nonzero to stop
+ * the enumeration there. a NULL fn turns checkpoints off */
+void pseudoku_set_checkpoint(struct pseudoku *ctx, double seconds,
+                             pseudoku_checkpoint_fn fn, void *arg) {
+    ctx->every = fn ? seconds : 0;
+    ctx->checkpoint = fn;
+    ctx->checkpoint_arg = arg;
+}
+
+/* parse a grid in single line format (see grid.h) into cells. returns the
+ * grid's box side, or 0 if the line is not a grid */
+int pseudoku_parse(const char *line, uint8_t *cells) {
+    struct grid g;
+    if (!grid_parse_line(&g, line)) {
+        return 0;
+    }
+    memcpy(cells, g.cells, g.side * g.side);
+    return g.box;
+}
+
+/* read the next grid in single line format, skipping blank lines and
+ * comments. returns the grid's box side, 0 at the end of the input, or
+ * PSEUDOKU_INVALID for a line which is not a grid */
+int pseudoku_read(FILE *f, uint8_t *cells) {
+    struct grid g;
+    int res = grid_read_line(&g, f);
+    if (res != 1) {
+        return res ? PSEUDOKU_INVALID : 0;
+    }
+    memcpy(cells, g.cells, g.side * g.side);
+    return g.box;
+}
+
+/* write a grid in single line format, with a terminator. returns the
+ * length written */
+int pseudoku_format(int box, const uint8_t *cells, char *line) {
+    struct grid g;
+    g.box = box;
+    g.side = box * box;
+    memcpy(g.cells, cells, g.side * g.side);
+    grid_to_line(&g, line);
+    line[g.side * g.side] = '\0';
+    return g.side * g.side;
+}
+
+int _pseudoku_box_ok(int box) {
+    return box >= PSEUDOKU_BOX_MIN && box <= PSEUDOKU_BOX_MAX;
+}
+
+/* load a 9x9 grid into a puzzle with its pencil marks filled in. returns 0
+ * if the givens already clash */
+int _pseudoku_load(const uint8_t *cells, puzzle puz) {
+    struct grid g;
+    g.box = 3;
+    g.side = GROUP_LENGTH;
+    memcpy(g.cells, cells, BOARD_LENGTH);
+    grid_to_puzzle(&g, puz);
+    puzzle_pencil_possibilities(puz);
+    return puzzle_is_consistent(puz);
+}
+
+void _pseudoku_store(puzzle puz, uint8_t *cells) {
+    for (int i = 0; i < BOARD_LENGTH; i++) {
+        struct cell *c = &puz[i % GROUP_LENGTH][i / GROUP_LENGTH];
+        cells[i] = c->complete ? c->u.ink : 0;
+    }
+}
+
+/* count the solutions of a grid, stopping once max have been found, and
+ * handing each to the context's sink. the logic solver, its board and its
+ * strategies are built for 9x9 only, so other sizes are searched with
+ * dancing links whatever engine was picked. if there is one, the first
+ * found is left in cells. the cancel flag is cleared once the search is
+ * over, so a cancel made between calls stops the next one as soon as it
+ * starts. returns PSEUDOKU_NO_MEMORY if the search could not get its
+ * memory */
+int _pseudoku_search(struct pseudoku *ctx, int box, uint8_t *cells,
+                     int max) {
+    uint64_t count = 0;
+    puzzle puz;
+    if (box != 3) {
+        count = dlx_search_sized(box, cells, max, ctx->opts.stats,
+                                 &ctx->space->arenas, &ctx->sink);
+    } else if (_pseudoku_load(cells, puz)) {
+        count = puzzle_enumerate(puz, max, &ctx->opts);
+        if (count && count != ENUMERATE_NO_MEMORY) {
+            _pseudoku_store(puz, cells);
+        }
+    }
+    ctx->cancelled = __atomic_exchange_n(&ctx->cancel, 0, __ATOMIC_RELAXED);
+    return count == ENUMERATE_NO_MEMORY ? PSEUDOKU_NO_MEMORY : (int) count;
+}
+
+/* solve a grid in place. returns 1 if it was solved, or 0, with the grid
+ * left as it was, if it has no solution (or the call was cancelled), or
+ * PSEUDOKU_NO_MEMORY */
+int pseudoku_solve(struct pseudoku *ctx, int box, uint8_t *cells) {
+    if (!_pseudoku_box_ok(box)) {
+        return PSEUDOKU_INVALID;
+    }
+    return _pseudoku_search(ctx, box, cells, 1);
+}
+
+/* count the solutions of a grid, stopping once max have been found (or
+ * the call is cancelled). returns the count, or PSEUDOKU_NO_MEMORY */
+int pseudoku_count(struct pseudoku *ctx, int box, const uint8_t *cells,
+                   int max) {
+    uint8_t work[PSEUDOKU_CELLS_MAX];
+    if (!_pseudoku_box_ok(box)) {
+        return PSEUDOKU_INVALID;
+    }
+    if (max <= 0) {
+        return 0;
+    }
+    memcpy(work, cells, box * box * box * box);
+    return _pseudoku_search(ctx, box, work, max);
+}
+
+/* run a count job (see count.h) from a grid, or from the state of one if
+ * state is not NULL, with the context's options, pool and checkpoints */
+int _pseudoku_job(struct pseudoku *ctx, int box, const uint8_t *cells,
+                  const char *state, uint64_t limit, pseudoku_solution_fn fn,
+                  void *arg, uint64_t *found) {
+    struct count_opts opts;
+    int res;
+    count_opts_init(&opts);
+    opts.search = &ctx->opts;
+    opts.cancel = &ctx->cancel;
+    opts.limit = limit;
+    opts.fn = fn;
+    opts.arg = arg;
+    opts.every = ctx->every;
+    opts.checkpoint = ctx->checkpoint;
+    opts.checkpoint_arg = ctx->checkpoint_arg;
+    if (!fn && !limit && _pseudoku_pool_ready(ctx)) {
+        opts.pool = &ctx->pool;
+        opts.spaces = ctx->spaces;
+    } else {
+        opts.spaces = &ctx->space;
+    }
+    res = state ? count_resume(state, &opts, found) :
+                  count_run(box, cells, &opts, found);
+    ctx->cancelled = __atomic_exchange_n(&ctx->cancel, 0, __ATOMIC_RELAXED);
+    if (res == COUNT_BAD_STATE) {
+        return PSEUDOKU_INVALID;
+    }
+    if (res == COUNT_NO_MEMORY) {
+        return PSEUDOKU_NO_MEMORY;
+    }
+    return res == COUNT_STOPPED ? PSEUDOKU_STOPPED : 0;
+}
+
+/* find the solutions of a grid one at a time, calling fn (if not NULL)
+ * with each as it is found, until limit have been found (0 for no limit),
+ * fn returns nonzero, or the call is cancelled. nothing is kept between
+ * solutions, so this runs in the same memory however many there are. the
+ * number found, including the one fn stopped at, goes in found. returns 0
+ * if every solution was found, PSEUDOKU_STOPPED if the search stopped
+ * short of that, PSEUDOKU_INVALID or PSEUDOKU_NO_MEMORY.
+ *
+ * a plain count, with no fn and no limit, is spread over the context's
+ * threads (see pseudoku_set_threads and count.h), and comes to the same
+ * total whatever the number of threads. with checkpoints on (see
+ * pseudoku_set_checkpoint), a cancelled call hands its state to the
+ * checkpoint callback before it returns */
+int pseudoku_enumerate(struct pseudoku *ctx, int box, const uint8_t *cells,
+                       uint64_t limit, pseudoku_solution_fn fn, void *arg,
+                       uint64_t *found) {
+    *found = 0;
+    if (!_pseudoku_box_ok(box)) {
+        return PSEUDOKU_INVALID;
+    }
+    return _pseudoku_job(ctx, box, cells, NULL, limit, fn, arg, found);
+}
+
+/* carry on with an enumeration from the state handed to a checkpoint, as
+ * if it had never stopped: the solutions it found before are in found
+ * (and count towards limit), but are not seen by fn again. the threads
+ * and the rest of the options need not be those it was started with.
+ * returns as pseudoku_enumerate, or PSEUDOKU_INVALID if the state cannot
+ * be read */
+int pseudoku_resume(struct pseudoku *ctx, const char *state, uint64_t limit,
+                    pseudoku_solution_fn fn, void *arg, uint64_t *found) {
+    *found = 0;
+    return _pseudoku_job(ctx, 0, NULL, state, limit, fn, arg, found);
+}
+
+/* stop the call the context is running, from another thread or a signal
+ * handler: a search notices within a node or so, and returns what it has
+ * found so far. if the context is idle, its next call is the one stopped */
+void pseudoku_cancel(struct pseudoku *ctx) {
+    __atomic_store_n(&ctx->cancel, 1, __ATOMIC_RELAXED);
+}
+
+/* withdraw a cancel which has not stopped anything yet, as when it was
+ * made just as the call it was meant for returned. only the thread using
+ * the context may call this */
+void pseudoku_uncancel(struct pseudoku *ctx) {
+    __atomic_store_n(&ctx->cancel, 0, __ATOMIC_RELAXED);
+}
+
+/* whether the context's last call was stopped by a cancel */
+int pseudoku_cancelled(const struct pseudoku *ctx) {
+    return ctx->cancelled;
+}
+
+/* rate a 9x9 grid (see rating.h). returns the number of solutions, up to
+ * 2; the grade is only meaningful when there is exactly one. if rating is
+ * not NULL, the rating is also written there as rating_format does, which
+ * takes up to PSEUDOKU_RATING_MAX characters */
+int pseudoku_rate(struct pseudoku *ctx, const uint8_t *cells, double *grade,
+                  char *rating) {
+    struct rating r;
+    puzzle puz;
+    /* nothing here polls the cancel flag */
+    ctx->cancelled = 0;
+    memset(&r, 0, sizeof r);
+    if (_pseudoku_load(cells, puz)) {
+        puzzle_rate(puz, &r, ctx->space);
+        /* the rating keeps its counters in the workspace */
+        if (ctx->opts.stats) {
+            stats_add(ctx->opts.stats, &ctx->space->stats);
+        }
+    }
+    if (grade) {
+        *grade = r.grade;
+    }
+    if (rating) {
+        rating_format(&r, rating);
+    }
+    return r.solutions;
+}
+
+/* generate the 9x9 puzzle for a seed. the same seed gives the same puzzle
+ * whatever the number of threads. returns 1 */
+int pseudoku_generate(struct pseudoku *ctx, uint64_t seed, uint8_t *cells) {
+    puzzle puz;
+    /* nothing here polls the cancel flag */
+    ctx->cancelled = 0;
+    if (_pseudoku_pool_ready(ctx)) {
+        puzzle_generate_parallel(puz, seed, &ctx->pool, ctx->spaces,
+                                 ctx->opts.stats);
+    } else {
+        puzzle_generate_seeded(puz, seed, ctx->space, ctx->opts.stats);
+    }
+    _pseudoku_store(puz, cells);
+    return 1;
+}
+
+/* generate a 9x9 puzzle whose grade is between lo and hi, as
+ * puzzle_generate_graded. returns 1 with the puzzle, its grade and (if
+ * rating is not NULL) its formatted rating, or 0 if the band was not
+ * reached from this seed */
+int pseudoku_generate_graded(struct pseudoku *ctx, uint64_t seed, double lo,
+                             double hi, uint8_t *cells, double *grade,
+                             char *rating) {
+    struct rating r;
+    puzzle puz;
+    /* nothing here polls the cancel flag */
+    ctx->cancelled = 0;
+    if (!puzzle_generate_graded(puz, seed, lo, hi, &r, ctx->space,
+                                ctx->opts.stats)) {
+        return 0;
+    }
+    _pseudoku_store(puz, cells);
+    if (grade) {
+        *grade = r.grade;
+    }
+    if (rating) {
+        rating_format(&r, rating);
+    }
+    return 1;
+}
+
+struct pseudoku_corpus {
+    struct packed packed;
+};
+
+/* whether a file starts as a packed corpus does, so that one which then
+ * fails to open is known to be damaged rather than text */
+int pseudoku_corpus_sniff(const char *path) {
+    return packed_sniff(path);
+}
+
+/* map a packed corpus. returns NULL if the file cannot be opened, or is
+ * not a packed corpus */
+struct pseudoku_corpus *pseudoku_corpus_open(const char *path) {
+    struct pseudoku_corpus *corpus = malloc(sizeof *corpus);
+    if (corpus && !packed_open(&corpus->packed, path)) {
+        free(corpus);
+        return NULL;
+    }
+    return corpus;
+}
+
+uint64_t pseudoku_corpus_count(const struct pseudoku_corpus *corpus) {
+    return corpus->packed.count;
+}
+
+const uint8_t *pseudoku_corpus_record(const struct pseudoku_corpus *corpus,
+                                      uint64_t i) {
+    return packed_record(&corpus->packed, i);
+}
+
+void pseudoku_corpus_close(struct pseudoku_corpus *corpus) {
+    if (corpus) {
+        packed_close(&corpus->packed);
+        free(corpus);
+    }
+}
+
+void pseudoku_pack(const uint8_t *cells, uint8_t *record) {
+    packed_encode(cells, record);
+}
+
+/* unpack a record into 81 cells. returns 0 if it does not hold a grid */
+int pseudoku_unpack(const uint8_t *record, uint8_t *cells) {
+    return packed_decode(record, cells);
+}
+
+/* fill in the header for a corpus of count records, or 0 if the count is
+ * not known up front */
+void pseudoku_pack_header(uint8_t *header, uint64_t count) {
+    packed_header(header, count);
+}
+
+void pseudoku_stats(const struct pseudoku *ctx, struct pseudoku_stats *s) {
+    s->nodes = ctx->stats.nodes;
+    s->guesses = ctx->stats.guesses;
+    s->backtracks = ctx->stats.backtracks;
+    s->max_depth = ctx->stats.max_depth;
+    s->eliminated = ctx->stats.eliminated;
+    s->filled = ctx->stats.filled;
+}
+
+void pseudoku_stats_add(struct pseudoku *dst, const struct pseudoku *src) {
+    stats_add(&dst->stats, &src->stats);
+}
+
+void pseudoku_stats_reset(struct pseudoku *ctx) {
+    stats_reset(&ctx->stats);
+}
+
+void pseudoku_stats_print(const struct pseudoku *ctx, FILE *f) {
+    stats_print(&ctx->stats, f);
+}
+
+/* the hidden single kernel, by name (see hidden_kernel_names) */
+int pseudoku_select_kernel(const char *name) {
+    int k = hidden_kernel_by_name(name);
+    if (k < 0) {
+        return PSEUDOKU_INVALID;
+    }
+    hidden_select(k);
+    return 0;
+}
+
+/* turn on a strategy which is off by default, by name (see
+ * strategy_name) */
+int pseudoku_enable_strategy(const char *name) {
+    int s = strategy_by_name(name);
+    if (s < 0) {
+        return PSEUDOKU_INVALID;
+    }
+    strategy_enable(s, 1);
+    return 0;
+}
@@ -0,0 +1,135 @@
+#ifndef __PSEUDOKU_H__
+#define __PSEUDOKU_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* the shared library is built with its symbols hidden, and exports only
+ * the calls declared here */
+#ifdef __GNUC__
+#define PSEUDOKU_API __attribute__((visibility("default")))
+#else
+#define PSEUDOKU_API
+#endif
+
+/* libpseudoku: the solver, counter, rater and generator behind the sudoku
+ * command, for embedding in other programs.
+ *
+ * all the work goes through a context, which owns its options, its scratch
+ * memory and its counters. a context must only be used by one thread at a
+ * time, but any number of contexts can be in use at once on different
+ * threads, with no locking between them.
+ *
+ * grids are passed as one digit per cell in row major order, with 0 for a
+ * blank cell, and box is the side of one box: 3 for the usual 9x9 grid,
+ * and 2, 4 or 5 for 4x4, 16x16 or 25x25. 9x9 grids go through the logic
+ * solver (or the engine picked with pseudoku_set_engine); the other sizes
+ * are always solved with dancing links. only 9x9 grids can be rated or
+ * generated.
+ *
+ * calls which take a grid return PSEUDOKU_INVALID if box is not one of the
+ * supported sizes, or if a grid must be 9x9 and is not. a solve, count or
+ * enumeration returns PSEUDOKU_NO_MEMORY if it ran out of memory, in which
+ * case an enumeration's count is short.
+ *
+ * a search can be stopped with pseudoku_cancel, which is the one call
+ * that may be made on a context while another thread is using it */
+#define PSEUDOKU_BOX_MIN 2
+#define PSEUDOKU_BOX_MAX 5
+#define PSEUDOKU_CELLS_MAX 625
+#define PSEUDOKU_INVALID -1
+#define PSEUDOKU_STOPPED 1
+#define PSEUDOKU_NO_MEMORY -2
+
+/* room for a grid in single line format, or for a rating, including the
+ * terminator */
+#define PSEUDOKU_LINE_MAX (PSEUDOKU_CELLS_MAX + 1)
+#define PSEUDOKU_RATING_MAX 64
+
+struct pseudoku;
+
+/* called by pseudoku_enumerate with each solution, as one digit per cell;
+ * the cells are only valid for the call. returns nonzero to stop */
+typedef int (*pseudoku_solution_fn)(const uint8_t *cells, void *arg);
+
+/* called with the state of an enumeration at each checkpoint, as text
+ * which is only valid for the call. returns nonzero to stop */
+typedef int (*pseudoku_checkpoint_fn)(const char *state, void *arg);
+
+/* the headline counters; see stats.h for what they count */
+struct pseudoku_stats {
+    uint64_t nodes;
+    uint64_t guesses;
+    uint64_t backtracks;
+    uint64_t max_depth;
+    uint64_t eliminated;
+    uint64_t filled;
+};
+
+PSEUDOKU_API struct pseudoku *pseudoku_new(void);
+PSEUDOKU_API void pseudoku_free(struct pseudoku *ctx);
+PSEUDOKU_API int pseudoku_set_engine(struct pseudoku *ctx, const char *name);
+PSEUDOKU_API void pseudoku_set_stats(struct pseudoku *ctx, int on);
+PSEUDOKU_API void pseudoku_set_threads(struct pseudoku *ctx, int threads);
+PSEUDOKU_API void pseudoku_set_checkpoint(struct pseudoku *ctx, double seconds,
+                                          pseudoku_checkpoint_fn fn, void *arg);
+
+PSEUDOKU_API int pseudoku_parse(const char *line, uint8_t *cells);
+PSEUDOKU_API int pseudoku_read(FILE *f, uint8_t *cells);
+PSEUDOKU_API int pseudoku_format(int box, const uint8_t *cells, char *line);
+
+PSEUDOKU_API int pseudoku_solve(struct pseudoku *ctx, int box, uint8_t *cells);
+PSEUDOKU_API int pseudoku_count(struct pseudoku *ctx, int box,
+                                const uint8_t *cells, int max_solutions);
+PSEUDOKU_API int pseudoku_enumerate(struct pseudoku *ctx, int box,
+                                    const uint8_t *cells, uint64_t limit,
+                                    pseudoku_solution_fn fn, void *arg,
+                                    uint64_t *found);
+PSEUDOKU_API int pseudoku_resume(struct pseudoku *ctx, const char *state,
+                                 uint64_t limit, pseudoku_solution_fn fn,
+                                 void *arg, uint64_t *found);
+PSEUDOKU_API void pseudoku_cancel(struct pseudoku *ctx);
+PSEUDOKU_API void pseudoku_uncancel(struct pseudoku *ctx);
+PSEUDOKU_API int pseudoku_cancelled(const struct pseudoku *ctx);
+PSEUDOKU_API int pseudoku_rate(struct pseudoku *ctx, const uint8_t *cells,
+                               double *grade, char *rating);
+PSEUDOKU_API int pseudoku_generate(struct pseudoku *ctx, uint64_t seed,
+                                   uint8_t *cells);
+PSEUDOKU_API int pseudoku_generate_graded(struct pseudoku *ctx, uint64_t seed,
+                                          double lo, double hi, uint8_t *cells,
+                                          double *grade, char *rating);
+
+/* packed corpora: 9x9 grids at PSEUDOKU_PACKED_RECORD bytes each, behind a
+ * header of PSEUDOKU_PACKED_HEADER bytes (see packed.h for the layout). an
+ * open corpus is mapped into memory, and its records are views into the
+ * mapping, which stay valid until it is closed; any number of threads can
+ * unpack them at once */
+#define PSEUDOKU_PACKED_HEADER 16
+#define PSEUDOKU_PACKED_RECORD 41
+
+struct pseudoku_corpus;
+
+PSEUDOKU_API int pseudoku_corpus_sniff(const char *path);
+PSEUDOKU_API struct pseudoku_corpus *pseudoku_corpus_open(const char *path);
+PSEUDOKU_API uint64_t pseudoku_corpus_count(
+    const struct pseudoku_corpus *corpus);
+PSEUDOKU_API const uint8_t *pseudoku_corpus_record(
+    const struct pseudoku_corpus *corpus, uint64_t i);
+PSEUDOKU_API void pseudoku_corpus_close(struct pseudoku_corpus *corpus);
+PSEUDOKU_API void pseudoku_pack(const uint8_t *cells, uint8_t *record);
+PSEUDOKU_API int pseudoku_unpack(const uint8_t *record, uint8_t *cells);
+PSEUDOKU_API void pseudoku_pack_header(uint8_t *header, uint64_t count);
+
+PSEUDOKU_API void pseudoku_stats(const struct pseudoku *ctx,
+                                 struct pseudoku_stats *s);
+PSEUDOKU_API void pseudoku_stats_add(struct pseudoku *dst,
+                                     const struct pseudoku *src);
+PSEUDOKU_API void pseudoku_stats_reset(struct pseudoku *ctx);
+PSEUDOKU_API void pseudoku_stats_print(const struct pseudoku *ctx, FILE *f);
+
+/* process wide settings, shared by every context: these must be made
+ * before any context is put to work */
+PSEUDOKU_API int pseudoku_select_kernel(const char *name);
+PSEUDOKU_API int pseudoku_enable_strategy(const char *name);
+
+#endif
@@ -1,9 +1,10 @@
 #include <assert.h>
+#include <string.h>
 
 #include "cell.h"
 #include "debug.h"
 #include "puzzle.h"
-#include "iter.h"
+#include "units.h"
 #include "constants.h"
 
 const char *sep = "-------------------------------------\n";
@@ -32,21 +33,51 @@ int puzzle_read(puzzle puz, FILE *f) {
     return 1;
 }
 
-void puzzle_pencil_possibilities(puzzle puz) {
-    for (enum iter_type t = ROW; t <= BOX; t++) {
-        for (int i = 0; i < 9; i++) {
-            struct iter it;
-            struct cell *c;
-            uint16_t inked = 0;
-            iter_init(&it, t, i);
-            while ((c = iter_next(&it, puz))) {
-                if (c->complete) {
-                    inked |= 0x1 << (c->u.ink - 1);
-                }
-            }
-            iter_init(&it, t, i);
-            iter_mask(&it, puz, inked);
+/* parse the common single line format: 81 characters in row major order,
+ * digits for inked cells and '.' or '0' for blanks. anything after the 81st
+ * character (such as a trailing comment or whitespace) is ignored */
+int puzzle_parse_line(puzzle puz, const char *line) {
+    for (int i = 0; i < BOARD_LENGTH; i++) {
+        int x = i % GROUP_LENGTH;
+        int y = i / GROUP_LENGTH;
+        char c = line[i];
+        if (c == '.' || c == '0') {
+            puz[x][y].complete = 0;
+            puz[x][y].u.pencil = ALL_POS;
+        } else if (c >= '1' && c <= '9') {
+            puz[x][y].complete = 1;
+            puz[x][y].u.ink = c - '0';
+        } else {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* read the next puzzle in single line format, skipping empty lines and
+ * lines starting with '#'. returns 1 if a puzzle was read, 0 at the end of
+ * the input and INCONSISTENT if the line could not be parsed */
+int puzzle_read_line(puzzle puz, FILE *f) {
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+        size_t len = strlen(line);
+        if (len == sizeof(line) - 1 && line[len - 1] != '\n') {
+            /* overlong line, discard the rest of it */
+            int c;
+            while ((c = getc(f)) != EOF && c != '\n');
+            return INCONSISTENT;
         }
+        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') {
+            continue;
+        }
+        return puzzle_parse_line(puz, line) ? 1 : INCONSISTENT;
+    }
+    return 0;
+}
+
+void puzzle_pencil_possibilities(puzzle puz) {
+    for (int u = 0; u < UNIT_COUNT; u++) {
+        unit_mask(puz, u, unit_inked(puz, u));
     }
 }
 
@@ -91,30 +122,26 @@ void puzzle_print_short(puzzle puz, FILE *f) {
     }
 }
 
+/* write the puzzle into line in single line format, without terminating it */
+void puzzle_to_line(puzzle puz, char *line) {
+    for (int i = 0; i < BOARD_LENGTH; i++) {
+        struct cell *c = &puz[i % GROUP_LENGTH][i / GROUP_LENGTH];
+        line[i] = c->complete ? c->u.ink + '0' : '.';
+    }
+}
+
+void puzzle_print_line(puzzle puz, FILE *f) {
+    char line[BOARD_LENGTH + 1];
+    puzzle_to_line(puz, line);
+    line[BOARD_LENGTH] = '\n';
+    fwrite(line, 1, sizeof line, f);
+}
+
 int puzzle_is_consistent(puzzle puz) {
-    for (enum iter_type t = ROW; t <= BOX; t++) {
-        for (int i = 0; i < 9; i++) {
-            struct cell *c;
-            struct iter it;
-            uint16_t seen = 0;
-            iter_init(&it, t, i);
-            int j = 0;
-            while ((c = iter_next(&it, puz))) {
-                if (c->complete) {
-                    uint16_t here = 0x1 << (c->u.ink - 1);
-                    if (here & seen) {
-                        dprintf("%s %d %d\n", iter_type_to_string[t], i, j++);
-                        return 0;
-                    } else {
-                        seen |= here;
-                    }
-                }
-            }
-            /*
-            if (seen != 0x1ff) {
-                return 0;
-            }
-            */
+    for (int u = 0; u < UNIT_COUNT; u++) {
+        if (!unit_consistent(puz, u)) {
+            dprintf("%s %d\n", unit_type_names[u / 9], u % 9);
+            return 0;
         }
     }
     return 1;
@@ -151,14 +178,14 @@ void puzzle_fill_cell(puzzle puz, int x, int y, int n) {
     assert(!puz[x][y].complete);
     puz[x][y].complete = 1;
     puz[x][y].u.ink = n;
-    int mask = ink_to_pencil(n);
-    struct iter it;
-    iter_init(&it, ROW, y);
-    iter_mask(&it, puz, mask);
-    iter_init(&it, COL, x);
-    iter_mask(&it, puz, mask);
-    iter_init(&it, BOX, (y / 3) * 3 + x / 3);
-    iter_mask(&it, puz, mask);
+    uint16_t rev = ~ink_to_pencil(n);
+    int cell = CELL_AT(x, y);
+    for (int p = 0; p < PEER_COUNT; p++) {
+        struct cell *c = peer_cell(puz, cell, p);
+        if (!c->complete) {
+            c->u.pencil &= rev;
+        }
+    }
 }
 
 void puzzle_clear_cell(puzzle puz, int x, int y) {
@@ -3,9 +3,13 @@
 
 #include "cell.h"
 int puzzle_read(puzzle puz, FILE *f);
+int puzzle_parse_line(puzzle puz, const char *line);
+int puzzle_read_line(puzzle puz, FILE *f);
 void puzzle_pencil_possibilities(puzzle puz);
 void puzzle_print(puzzle puz, FILE *f);
 void puzzle_print_short(puzzle puz, FILE *f);
+void puzzle_to_line(puzzle puz, char *line);
+void puzzle_print_line(puzzle puz, FILE *f);
 int puzzle_is_consistent(puzzle puz);
 int puzzle_noninked_count(puzzle puz);
 void puzzle_copy(puzzle src, puzzle dst);
@@ -0,0 +1,118 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "rating.h"
+#include "board.h"
+#include "puzzle.h"
+#include "strategy.h"
+#include "backtrack.h"
+#include "constants.h"
+
+/* the level of strategy i: its place among the enabled strategies,
+ * counting from 1. strategy_count() gives the level of guessing */
+int _rating_level(int i) {
+    int level = 1;
+    for (int j = 0; j < i; j++) {
+        level += strategy_enabled(j);
+    }
+    return level;
+}
+
+/* a fraction in [0, 1) which grows with n */
+double _rating_fraction(uint32_t n) {
+    return n / (n + 10.0);
+}
+
+void _rate_in(struct workspace *ws, puzzle puz, struct rating *r) {
+    struct board *b = &ws->board;
+    struct stats *stats = &ws->stats;
+    memset(r, 0, sizeof *r);
+    stats_reset(stats);
+    board_load(b, puz);
+    b->stats = stats;
+    if (board_logic(b) == INCONSISTENT) {
+        return;
+    }
+    int hardest = -1;
+    for (int i = 0; i < strategy_count(); i++) {
+        r->uses[i] = stats->strategy[i].productive;
+        if (r->uses[i]) {
+            hardest = i;
+        }
+    }
+    if (b->unfilled == 0) {
+        /* every deduction is forced, so there is only the one solution */
+        r->solutions = 1;
+        if (hardest >= 0) {
+            r->grade = _rating_level(hardest) +
+                       _rating_fraction(r->uses[hardest]);
+        }
+        return;
+    }
+
+    /* the search starts over on the workspace's board, so it searches a
+     * copy of what the logic left. its counters are kept apart, for the
+     * guesses and depth of the rating, and then added to the logic's, so
+     * that the workspace's stats cover the whole rating */
+    struct search_opts opts;
+    struct stats search;
+    puzzle copy;
+    search_opts_init(&opts);
+    stats_reset(&search);
+    opts.stats = &search;
+    opts.space = ws;
+    puzzle_copy(b->grid, copy);
+    r->solutions = puzzle_search(copy, 2, &opts);
+    r->guesses = search.guesses;
+    r->depth = search.max_depth;
+    stats_add(stats, &search);
+    r->grade = _rating_level(strategy_count()) +
+               _rating_fraction(r->guesses);
+}
+
+/* rate a puzzle, whose pencil marks must be filled in; puz is not changed.
+ * the work is done in ws, or in a workspace made for the call if ws is
+ * NULL. returns 1, or 0 if no workspace could be made */
+int puzzle_rate(puzzle puz, struct rating *r, struct workspace *ws) {
+    if (ws) {
+        _rate_in(ws, puz, r);
+        return 1;
+    }
+    ws = workspace_new();
+    if (!ws) {
+        return 0;
+    }
+    _rate_in(ws, puz, r);
+    workspace_free(ws);
+    return 1;
+}
+
+/* add to a line of len characters, up to RATING_LINE_MAX in all. returns
+ * the new length */
+int _rating_append(char *line, int len, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(line + len, RATING_LINE_MAX + 1 - len, format, args);
+    va_end(args);
+    return n < 0 || n > RATING_LINE_MAX - len ? RATING_LINE_MAX : len + n;
+}
+
+/* write a rating as "grade uses,uses,... guesses depth", or as
+ * "inconsistent" or "multiple" for a puzzle without a unique solution,
+ * into line, which has room for RATING_LINE_MAX characters and a
+ * terminator. returns the length written */
+int rating_format(const struct rating *r, char *line) {
+    if (r->solutions != 1) {
+        return _rating_append(line, 0, "%s",
+                              r->solutions ? "multiple" : "inconsistent");
+    }
+    int len = _rating_append(line, 0, "%.2f", r->grade);
+    for (int i = 0, n = 0; i < strategy_count(); i++) {
+        if (strategy_enabled(i)) {
+            len = _rating_append(line, len, "%s%u", n++ ? "," : " ",
+                                 r->uses[i]);
+        }
+    }
+    return _rating_append(line, len, " %u %u", r->guesses, r->depth);
+}
@@ -0,0 +1,40 @@
+#ifndef __RATING_H__
+#define __RATING_H__
+
+#include <stdint.h>
+
+#include "cell.h"
+#include "stats.h"
+#include "backtrack.h"
+
+/* longest line written by rating_format, without a terminator; anything
+ * past it is cut off. with the terminator, it fits in PSEUDOKU_RATING_MAX
+ * (see pseudoku.h) */
+#define RATING_LINE_MAX 63
+
+/* how hard a puzzle is to solve by hand. the strategies are tried
+ * cheapest first, so a strategy only makes progress when every cheaper
+ * one is stuck; uses counts those productive runs for each strategy (see
+ * strategy_name), up to the point where logic alone runs dry. disabled
+ * strategies take no part, and are left out of the formatted rating. only then
+ * does the search guess, and guesses and depth record how much of that it
+ * had to do, proving uniqueness included.
+ *
+ * the grade is the level of the hardest technique needed, counting the
+ * enabled strategies from 1 in cost order and guessing as one past the
+ * last, plus a fraction which grows with how often that technique was
+ * needed. so with the current strategies, 1.x needs only naked singles,
+ * 2.x hidden singles, 3.x subgroup exclusion, and 4 and up needs guessing
+ * (or subsets, when that is enabled, with guessing moving up to 5) */
+struct rating {
+    int solutions; /* 0, 1, or 2 for two or more */
+    double grade;
+    uint32_t uses[STATS_STRATEGIES];
+    uint32_t guesses;
+    uint32_t depth;
+};
+
+int puzzle_rate(puzzle puz, struct rating *r, struct workspace *ws);
+int rating_format(const struct rating *r, char *line);
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef __RNG_H__
+#define __RNG_H__
+
+#include <stdint.h>
+
+/* a small, fast pseudo random number generator (xoshiro256**), whose whole
+ * state lives in the struct, so that each thread or each puzzle can have
+ * its own, and the same seed always gives the same sequence. the state is
+ * spread out from the seed with splitmix64, so nearby seeds give unrelated
+ * sequences */
+struct rng {
+    uint64_t s[4];
+};
+
+static inline uint64_t _rng_splitmix(uint64_t *x) {
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static inline void rng_seed(struct rng *r, uint64_t seed) {
+    for (int i = 0; i < 4; i++) {
+        r->s[i] = _rng_splitmix(&seed);
+    }
+}
+
+static inline uint64_t _rng_rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t rng_next(struct rng *r) {
+    uint64_t *s = r->s;
+    uint64_t result = _rng_rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = _rng_rotl(s[3], 45);
+    return result;
+}
+
+/* a number in [0, n), without the bias of rng_next() % n (lemire's
+ * multiply and reject) */
+static inline uint32_t rng_below(struct rng *r, uint32_t n) {
+    uint64_t m = (uint64_t) (uint32_t) (rng_next(r) >> 32) * n;
+    if ((uint32_t) m < n) {
+        uint32_t threshold = -n % n;
+        while ((uint32_t) m < threshold) {
+            m = (uint64_t) (uint32_t) (rng_next(r) >> 32) * n;
+        }
+    }
+    return m >> 32;
+}
+
+#endif
@@ -0,0 +1,589 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "serve.h"
+#include "pseudoku.h"
+#include "pool.h"
+
+/* longest request or response line, including the newline */
+#define SERVE_LINE_MAX (PSEUDOKU_CELLS_MAX + 96)
+
+/* how long to wait before accepting again, when out of descriptors */
+#define SERVE_ACCEPT_BACKOFF_NS 10000000L
+
+/* how often the watchdog looks over the requests being worked on */
+#define SERVE_WATCH_NS 50000000L
+
+/* what a worker is busy with, for the watchdog */
+struct serve_busy {
+    struct serve_conn *conn; /* NULL when idle */
+    struct timespec start;
+    int cancelled;
+};
+
+/* the clients still connected are kept on a list, so that the pool and
+ * the contexts they use outlive them */
+struct server {
+    struct pool pool;
+    struct pseudoku **ctx; /* one per worker */
+    struct serve_busy *busy; /* one per worker */
+    int threads;
+    pthread_mutex_t lock;
+    pthread_cond_t gone;
+    pthread_cond_t stop;
+    int stopping;
+    struct serve_conn *conns;
+};
+
+/* one client. a worker never writes to the client itself: it queues the
+ * request, with its response, on the connection, and the connection's
+ * writer thread sends it, so a client which stops reading only holds up
+ * its own writer, and never a worker shared with other clients */
+struct serve_conn {
+    struct server *server;
+    struct serve_conn *next;
+    struct serve_conn *prev;
+    int in;
+    int out;
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t drained;
+    pthread_cond_t ready; /* responses queued, or the reader is done */
+    struct serve_request *head; /* responses waiting to be written */
+    struct serve_request *tail;
+    int inflight; /* read and not yet written */
+    int closed; /* no more requests will be read */
+    int dead; /* a write failed, so the client has gone */
+};
+
+struct serve_request {
+    struct serve_conn *conn;
+    struct serve_request *next;
+    struct timespec start;
+    int overlong;
+    int len;
+    char line[SERVE_LINE_MAX];
+    char response[SERVE_LINE_MAX + SERVE_ID_MAX + 64];
+};
+
+void serve_opts_init(struct serve_opts *opts) {
+    opts->socket = NULL;
+    opts->threads = 1;
+    opts->engine = "logic";
+}
+
+long _serve_micros(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000000L +
+           (now.tv_nsec - start->tv_nsec) / 1000;
+}
+
+/* returns 0 if the client has gone */
+int _serve_write(int fd, const char *buf, size_t len) {
+    while (len) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            return 0;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 1;
+}
+
+/* parse a whole word as an unsigned number, decimal or (with 0x) hex.
+ * returns 0 if it is not one, or is out of range */
+int _serve_number(const char *word, unsigned long long *n) {
+    char *end;
+    if (!isdigit((unsigned char) *word)) {
+        return 0;
+    }
+    errno = 0;
+    *n = strtoull(word, &end, 0);
+    return !*end && !errno;
+}
+
+/* run a request, writing its result into result. returns 1 on success, or
+ * 0 with an error message in result */
+int _serve_run(struct pseudoku *ctx, char *line, char *result) {
+    char *save;
+    char *op = strtok_r(line, " \t\r\n", &save);
+    char *arg = strtok_r(NULL, " \t\r\n", &save);
+    uint8_t cells[PSEUDOKU_CELLS_MAX];
+    int max = 2;
+    if (!op || !arg) {
+        strcpy(result, "malformed request");
+        return 0;
+    }
+    if (strcmp(op, "generate") == 0) {
+        unsigned long long seed;
+        if (!_serve_number(arg, &seed)) {
+            strcpy(result, "malformed request");
+            return 0;
+        }
+        pseudoku_generate(ctx, seed, cells);
+        pseudoku_format(3, cells, result);
+        return 1;
+    }
+    if (strcmp(op, "solve") != 0 && strcmp(op, "unique") != 0 &&
+        strcmp(op, "count") != 0 && strcmp(op, "rate") != 0) {
+        strcpy(result, "unknown request");
+        return 0;
+    }
+    if (strcmp(op, "count") == 0) {
+        unsigned long long n;
+        int number = _serve_number(arg, &n);
+        arg = strtok_r(NULL, " \t\r\n", &save);
+        if (!number || n < 1 || !arg) {
+            strcpy(result, "malformed request");
+            return 0;
+        }
+        max = n > SERVE_COUNT_MAX ? SERVE_COUNT_MAX : (int) n;
+    }
+    int box = pseudoku_parse(arg, cells);
+    if (!box) {
+        strcpy(result, "invalid grid");
+        return 0;
+    }
+    if (strcmp(op, "solve") == 0) {
+        int res = pseudoku_solve(ctx, box, cells);
+        if (res == PSEUDOKU_NO_MEMORY) {
+            strcpy(result, "out of memory");
+            return 0;
+        }
+        if (res == 1) {
+            pseudoku_format(box, cells, result);
+        } else {
+            strcpy(result, "inconsistent");
+        }
+    } else if (strcmp(op, "rate") != 0) {
+        int found = pseudoku_count(ctx, box, cells, max);
+        if (found == PSEUDOKU_NO_MEMORY) {
+            strcpy(result, "out of memory");
+            return 0;
+        }
+        sprintf(result, "%d", found);
+    } else if (box == 3) {
+        pseudoku_rate(ctx, cells, NULL, result);
+    } else {
+        strcpy(result, "only 9x9 grids can be rated");
+        return 0;
+    }
+    return 1;
+}
+
+void _serve_request(void *arg, int worker) {
+    struct serve_request *req = arg;
+    struct serve_conn *conn = req->conn;
+    struct pseudoku *ctx = conn->server->ctx[worker];
+    struct pseudoku_stats before;
+    struct pseudoku_stats after;
+    char result[SERVE_LINE_MAX];
+    char *id = req->line + strspn(req->line, " \t");
+    char *rest = id + strcspn(id, " \t\r\n");
+    int ok = 0;
+    if (*rest) {
+        *rest++ = '\0';
+    }
+    pseudoku_stats(ctx, &before);
+    if (strlen(id) > SERVE_ID_MAX) {
+        id = "-";
+        strcpy(result, "malformed request");
+    } else if (req->overlong) {
+        strcpy(result, "request too long");
+    } else {
+        struct server *s = conn->server;
+        struct serve_busy *busy = &s->busy[worker];
+        pthread_mutex_lock(&s->lock);
+        busy->conn = conn;
+        clock_gettime(CLOCK_MONOTONIC, &busy->start);
+        busy->cancelled = 0;
+        pthread_mutex_unlock(&s->lock);
+        ok = _serve_run(ctx, rest, result);
+        pthread_mutex_lock(&s->lock);
+        int cancelled = busy->cancelled;
+        busy->conn = NULL;
+        pthread_mutex_unlock(&s->lock);
+        if (pseudoku_cancelled(ctx)) {
+            ok = 0;
+            strcpy(result, "request took too long");
+        } else if (cancelled) {
+            /* the watchdog was too late to stop the call, and must not
+             * stop the next one instead */
+            pseudoku_uncancel(ctx);
+        }
+    }
+    pseudoku_stats(ctx, &after);
+    if (ok) {
+        req->len = sprintf(req->response, "%s ok %ld %llu %s\n", id,
+                           _serve_micros(&req->start),
+                           (unsigned long long) (after.nodes - before.nodes),
+                           result);
+    } else {
+        req->len = sprintf(req->response, "%s error 0 0 %s\n", id, result);
+    }
+    req->next = NULL;
+    pthread_mutex_lock(&conn->lock);
+    if (conn->tail) {
+        conn->tail->next = req;
+    } else {
+        conn->head = req;
+    }
+    conn->tail = req;
+    pthread_cond_signal(&conn->ready);
+    pthread_mutex_unlock(&conn->lock);
+}
+
+/* write a client's responses as they are queued, until the reader is done
+ * and nothing is left in flight. once a write fails the rest are dropped */
+void *_serve_writer(void *arg) {
+    struct serve_conn *conn = arg;
+    pthread_mutex_lock(&conn->lock);
+    while (1) {
+        while (!conn->head && !(conn->closed && !conn->inflight)) {
+            pthread_cond_wait(&conn->ready, &conn->lock);
+        }
+        struct serve_request *req = conn->head;
+        if (!req) {
+            break;
+        }
+        conn->head = conn->tail = NULL;
+        int dead = conn->dead;
+        pthread_mutex_unlock(&conn->lock);
+        int written = 0;
+        while (req) {
+            struct serve_request *next = req->next;
+            if (!dead && !_serve_write(conn->out, req->response, req->len)) {
+                dead = 1;
+            }
+            free(req);
+            req = next;
+            written++;
+        }
+        pthread_mutex_lock(&conn->lock);
+        __atomic_store_n(&conn->dead, dead, __ATOMIC_RELAXED);
+        conn->inflight -= written;
+        pthread_cond_signal(&conn->drained);
+    }
+    pthread_mutex_unlock(&conn->lock);
+    return NULL;
+}
+
+/* whether a client has gone: a write to it has failed, or it has hung up
+ * altogether (a client which has only shut down its sending side is still
+ * waiting for responses) */
+int _serve_gone(struct serve_conn *conn) {
+    struct pollfd p;
+    if (__atomic_load_n(&conn->dead, __ATOMIC_RELAXED)) {
+        return 1;
+    }
+    p.fd = conn->out;
+    p.events = 0;
+    return poll(&p, 1, 0) > 0 && (p.revents & (POLLHUP | POLLERR));
+}
+
+/* cancel each call which has run past SERVE_DEADLINE_MS, or whose client
+ * has gone, until the server stops */
+void *_serve_watchdog(void *arg) {
+    struct server *s = arg;
+    pthread_mutex_lock(&s->lock);
+    while (!s->stopping) {
+        for (int i = 0; i < s->threads; i++) {
+            struct serve_busy *busy = &s->busy[i];
+            if (!busy->conn || busy->cancelled) {
+                continue;
+            }
+            if (_serve_gone(busy->conn) ||
+                _serve_micros(&busy->start) > SERVE_DEADLINE_MS * 1000L) {
+                pseudoku_cancel(s->ctx[i]);
+                busy->cancelled = 1;
+            }
+        }
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_nsec += SERVE_WATCH_NS;
+        if (until.tv_nsec >= 1000000000L) {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&s->stop, &s->lock, &until);
+    }
+    pthread_mutex_unlock(&s->lock);
+    return NULL;
+}
+
+/* a client, put on the server's list */
+struct serve_conn *_serve_conn_new(struct server *s, int in, int out) {
+    struct serve_conn *conn = malloc(sizeof *conn);
+    if (!conn) {
+        return NULL;
+    }
+    conn->server = s;
+    conn->in = in;
+    conn->out = out;
+    conn->head = conn->tail = NULL;
+    conn->inflight = 0;
+    conn->closed = 0;
+    conn->dead = 0;
+    pthread_mutex_init(&conn->lock, NULL);
+    pthread_cond_init(&conn->drained, NULL);
+    pthread_cond_init(&conn->ready, NULL);
+    if (pthread_create(&conn->writer, NULL, _serve_writer, conn)) {
+        pthread_mutex_destroy(&conn->lock);
+        pthread_cond_destroy(&conn->drained);
+        pthread_cond_destroy(&conn->ready);
+        free(conn);
+        return NULL;
+    }
+    pthread_mutex_lock(&s->lock);
+    conn->prev = NULL;
+    conn->next = s->conns;
+    if (s->conns) {
+        s->conns->prev = conn;
+    }
+    s->conns = conn;
+    pthread_mutex_unlock(&s->lock);
+    return conn;
+}
+
+/* wait for the writer to send what is in flight, take a client off the
+ * server's list and free it; its descriptors are closed by the caller */
+void _serve_conn_free(struct serve_conn *conn) {
+    struct server *s = conn->server;
+    pthread_mutex_lock(&conn->lock);
+    conn->closed = 1;
+    pthread_cond_signal(&conn->ready);
+    pthread_mutex_unlock(&conn->lock);
+    pthread_join(conn->writer, NULL);
+    pthread_mutex_lock(&s->lock);
+    if (conn->prev) {
+        conn->prev->next = conn->next;
+    } else {
+        s->conns = conn->next;
+    }
+    if (conn->next) {
+        conn->next->prev = conn->prev;
+    }
+    pthread_cond_broadcast(&s->gone);
+    pthread_mutex_unlock(&s->lock);
+    pthread_mutex_destroy(&conn->lock);
+    pthread_cond_destroy(&conn->drained);
+    pthread_cond_destroy(&conn->ready);
+    free(conn);
+}
+
+/* hang up on every client still connected, and wait for each to finish
+ * the requests it has in flight */
+void _serve_hang_up(struct server *s) {
+    pthread_mutex_lock(&s->lock);
+    for (struct serve_conn *conn = s->conns; conn; conn = conn->next) {
+        shutdown(conn->in, SHUT_RD);
+    }
+    while (s->conns) {
+        pthread_cond_wait(&s->gone, &s->lock);
+    }
+    pthread_mutex_unlock(&s->lock);
+}
+
+/* read requests from a client until it hangs up (or stops taking
+ * responses), then wait for the last of its responses before closing it */
+void *_serve_conn(void *arg) {
+    struct serve_conn *conn = arg;
+    int fd = conn->in;
+    int out = conn->out;
+    FILE *in = fdopen(fd, "r");
+    struct serve_request *req = NULL;
+    while (in) {
+        if (!req && !(req = malloc(sizeof *req))) {
+            break;
+        }
+        if (!fgets(req->line, sizeof req->line, in)) {
+            break;
+        }
+        /* a line with a NUL in it is cut short there, perhaps to nothing */
+        size_t len = strlen(req->line);
+        req->overlong = len == sizeof req->line - 1 &&
+                        req->line[len - 1] != '\n';
+        if (req->overlong) {
+            /* keep the id for the error, and discard the rest of the line */
+            int c;
+            while ((c = getc(in)) != EOF && c != '\n');
+        }
+        if (strspn(req->line, " \t\r\n") == strlen(req->line)) {
+            continue;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &req->start);
+        req->conn = conn;
+        pthread_mutex_lock(&conn->lock);
+        while (conn->inflight >= SERVE_INFLIGHT && !conn->dead) {
+            pthread_cond_wait(&conn->drained, &conn->lock);
+        }
+        int dead = conn->dead;
+        if (!dead) {
+            conn->inflight++;
+        }
+        pthread_mutex_unlock(&conn->lock);
+        if (dead) {
+            break;
+        }
+        pool_submit(&conn->server->pool, _serve_request, req);
+        req = NULL;
+    }
+    free(req);
+    _serve_conn_free(conn);
+    if (in) {
+        fclose(in);
+    } else {
+        close(fd);
+    }
+    if (out != fd) {
+        close(out);
+    }
+    return NULL;
+}
+
+int _serve_socket(struct server *s, const char *path) {
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof addr.sun_path) {
+        fprintf(stderr, "%s: socket path too long\n", path);
+        return 1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return 1;
+    }
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    /* a socket left behind by an earlier server would block the bind */
+    unlink(path);
+    if (bind(fd, (struct sockaddr *) &addr, sizeof addr) < 0 ||
+        listen(fd, SOMAXCONN) < 0) {
+        perror(path);
+        close(fd);
+        return 1;
+    }
+    fprintf(stderr, "serving on %s with %d threads\n", path, s->threads);
+    while (1) {
+        int client = accept(fd, NULL, NULL);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno == EMFILE || errno == ENFILE || errno == ENOMEM ||
+                errno == ENOBUFS) {
+                /* out of descriptors or memory for now; a client hanging
+                 * up gives some back, so wait a little and try again */
+                struct timespec pause = { 0, SERVE_ACCEPT_BACKOFF_NS };
+                nanosleep(&pause, NULL);
+                continue;
+            }
+            perror("accept");
+            break;
+        }
+        struct serve_conn *conn = _serve_conn_new(s, client, client);
+        pthread_t thread;
+        if (!conn) {
+            close(client);
+            continue;
+        }
+        if (pthread_create(&thread, NULL, _serve_conn, conn)) {
+            _serve_conn_free(conn);
+            close(client);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+    close(fd);
+    _serve_hang_up(s);
+    return 1;
+}
+
+/* a context for each worker, counting nodes for the responses. returns
+ * -1 for a bad engine name, 0 if out of memory and 1 otherwise */
+int _serve_contexts(struct server *s, const char *engine) {
+    s->ctx = calloc(s->threads, sizeof *s->ctx);
+    s->busy = calloc(s->threads, sizeof *s->busy);
+    if (!s->ctx || !s->busy) {
+        return 0;
+    }
+    for (int i = 0; i < s->threads; i++) {
+        s->ctx[i] = pseudoku_new();
+        if (!s->ctx[i]) {
+            return 0;
+        }
+        if (pseudoku_set_engine(s->ctx[i], engine) < 0) {
+            return -1;
+        }
+        pseudoku_set_stats(s->ctx[i], 1);
+    }
+    return 1;
+}
+
+/* serve requests until stdin closes or, with a socket, until killed */
+int serve(const struct serve_opts *opts) {
+    struct server s;
+    int res = 1;
+    s.threads = opts->threads > 0 ? opts->threads : pool_cpu_count();
+    s.conns = NULL;
+    s.stopping = 0;
+    pthread_mutex_init(&s.lock, NULL);
+    pthread_cond_init(&s.gone, NULL);
+    pthread_cond_init(&s.stop, NULL);
+    pthread_t watchdog;
+    int made = _serve_contexts(&s, opts->engine);
+    if (made == 1 && !pool_init(&s.pool, s.threads)) {
+        made = 0;
+    } else if (made == 1 &&
+               pthread_create(&watchdog, NULL, _serve_watchdog, &s)) {
+        pool_destroy(&s.pool);
+        made = 0;
+    }
+    if (made == 1) {
+        /* a client which hangs up early must not take the server with it */
+        signal(SIGPIPE, SIG_IGN);
+        if (opts->socket) {
+            res = _serve_socket(&s, opts->socket);
+        } else {
+            struct serve_conn *conn = _serve_conn_new(&s, STDIN_FILENO,
+                                                      STDOUT_FILENO);
+            if (conn) {
+                _serve_conn(conn);
+                res = 0;
+            }
+        }
+        pool_destroy(&s.pool);
+        pthread_mutex_lock(&s.lock);
+        s.stopping = 1;
+        pthread_cond_signal(&s.stop);
+        pthread_mutex_unlock(&s.lock);
+        pthread_join(watchdog, NULL);
+    } else if (made < 0) {
+        res = -1;
+    }
+    for (int i = 0; s.ctx && i < s.threads; i++) {
+        pseudoku_free(s.ctx[i]);
+    }
+    free(s.ctx);
+    free(s.busy);
+    pthread_mutex_destroy(&s.lock);
+    pthread_cond_destroy(&s.gone);
+    pthread_cond_destroy(&s.stop);
+    return res;
+}
@@ -0,0 +1,50 @@
+#ifndef __SERVE_H__
+#define __SERVE_H__
+
+/* serve mode keeps one solver process alive for many requests, read from a
+ * unix domain socket (any number of clients at once) or from stdin, with
+ * responses on stdout. every request is one line:
+ *
+ *   ID solve GRID
+ *   ID unique GRID
+ *   ID count N GRID
+ *   ID rate GRID
+ *   ID generate SEED
+ *
+ * where ID is any word of up to SERVE_ID_MAX characters chosen by the
+ * client, and GRID is a grid of any supported size in single line format
+ * (only 9x9 grids can be rated). every request gets a one line response:
+ *
+ *   ID ok MICROS NODES RESULT
+ *   ID error 0 0 MESSAGE
+ *
+ * where MICROS is how long the server held the request, from reading it to
+ * writing the response, and NODES is the number of search nodes it took.
+ * RESULT is the solved grid (or "inconsistent"), the number of solutions
+ * found (stopping at 2 for unique, or N for count), the rating as written
+ * by rate --batch, or the generated puzzle.
+ *
+ * requests are handed to a pool of worker threads as soon as they are
+ * read, and each response is written as soon as it is ready, so a client
+ * may pipeline many requests and will get the responses out of order;
+ * the ID ties them back together. a client may have up to SERVE_INFLIGHT
+ * requests in flight before the server stops reading from it.
+ *
+ * a count stops at SERVE_COUNT_MAX solutions, whatever N asks for. a
+ * search which runs past SERVE_DEADLINE_MS, or whose client hangs up, is
+ * cancelled, and answered with an error */
+#define SERVE_ID_MAX 32
+#define SERVE_INFLIGHT 1024
+#define SERVE_COUNT_MAX 1000000
+#define SERVE_DEADLINE_MS 5000
+
+struct serve_opts {
+    const char *socket; /* NULL to serve stdin and stdout */
+    int threads;
+    const char *engine;
+};
+
+void serve_opts_init(struct serve_opts *opts);
+int serve(const struct serve_opts *opts);
+
+#endif
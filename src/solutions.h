@@ -0,0 +1,49 @@
+#ifndef __SOLUTIONS_H__
+#define __SOLUTIONS_H__
+
+#include <stdint.h>
+
+/* where a search hands out its solutions, for callers which want to see
+ * them as they are found rather than just count them, and how it learns
+ * that it should give up. fn, if not NULL, is called with each solution,
+ * as one digit per cell in row major order, and returns nonzero to stop
+ * the search there; the cells are only valid for the call. cancel, if not
+ * NULL, is polled at every node of the search, so setting it from another
+ * thread (or a signal handler) stops the search within a node or so.
+ *
+ * wanted, if not NULL, is also polled as the search goes (at every node,
+ * or every few in dancing links), and says whether to give work away.
+ * for SPLIT_ONE (someone is waiting for work), the search takes its
+ * shallowest guess with alternatives still untried, passes each of those
+ * to give as a grid of its own (the board as it was before the guess,
+ * plus the alternative, with 0 for blank), and carries on without them.
+ * for SPLIT_ALL (the search is to be saved, or paused), it gives away
+ * every untried alternative of every guess, and then the board it is on,
+ * if that might still lead anywhere, and stops. the grids come in the
+ * reverse of the order the search would have taken them, so that a stack
+ * of them comes off in the search's own order. every solution is either
+ * found by the search or in exactly one of the grids given away, so
+ * counts split this way add up exactly */
+#define SPLIT_NONE 0
+#define SPLIT_ONE 1
+#define SPLIT_ALL 2
+
+typedef int (*solution_fn)(const uint8_t *cells, void *arg);
+
+struct solutions {
+    solution_fn fn;
+    void *arg;
+    const int *cancel;
+    int (*wanted)(void *arg);
+    void (*give)(const uint8_t *cells, void *arg);
+};
+
+static inline int solutions_cancelled(const struct solutions *s) {
+    return s && s->cancel && __atomic_load_n(s->cancel, __ATOMIC_RELAXED);
+}
+
+static inline int solutions_wanted(const struct solutions *s) {
+    return s && s->wanted ? s->wanted(s->arg) : SPLIT_NONE;
+}
+
+#endif
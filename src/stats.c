@@ -0,0 +1,66 @@
+#include <string.h>
+
+#include "stats.h"
+#include "strategy.h"
+
+void stats_reset(struct stats *s) {
+    memset(s, 0, sizeof *s);
+}
+
+void stats_add(struct stats *dst, const struct stats *src) {
+    dst->unit_visits += src->unit_visits;
+    dst->unit_visits_saved += src->unit_visits_saved;
+    dst->cell_visits += src->cell_visits;
+    dst->cell_visits_saved += src->cell_visits_saved;
+    dst->nodes += src->nodes;
+    dst->guesses += src->guesses;
+    dst->backtracks += src->backtracks;
+    if (src->max_depth > dst->max_depth) {
+        dst->max_depth = src->max_depth;
+    }
+    dst->eliminated += src->eliminated;
+    dst->filled += src->filled;
+    for (int i = 0; i < STATS_STRATEGIES; i++) {
+        struct strategy_stats *d = &dst->strategy[i];
+        const struct strategy_stats *s = &src->strategy[i];
+        d->invocations += s->invocations;
+        d->productive += s->productive;
+        d->eliminated += s->eliminated;
+        d->filled += s->filled;
+        d->cycles += s->cycles;
+    }
+}
+
+double _stats_percent(uint64_t part, uint64_t whole) {
+    return whole ? 100.0 * part / whole : 0.0;
+}
+
+void stats_print(const struct stats *s, FILE *f) {
+    fprintf(f, "search: %llu nodes, %llu guesses, %llu backtracks, "
+            "max depth %llu\n",
+            (unsigned long long) s->nodes, (unsigned long long) s->guesses,
+            (unsigned long long) s->backtracks,
+            (unsigned long long) s->max_depth);
+    fprintf(f, "%-20s %12s %12s %12s %10s %12s\n", "strategy", "calls",
+            "productive", "eliminated", "filled", "kcycles");
+    for (int i = 0; i < strategy_count(); i++) {
+        const struct strategy_stats *ss = &s->strategy[i];
+        fprintf(f, "%-20s %12llu %12llu %12llu %10llu %12llu\n",
+                strategy_name(i),
+                (unsigned long long) ss->invocations,
+                (unsigned long long) ss->productive,
+                (unsigned long long) ss->eliminated,
+                (unsigned long long) ss->filled,
+                (unsigned long long) (ss->cycles / 1000));
+    }
+    fprintf(f, "unit visits: %llu (%llu saved by propagation, %.1f%%)\n",
+            (unsigned long long) s->unit_visits,
+            (unsigned long long) s->unit_visits_saved,
+            _stats_percent(s->unit_visits_saved,
+                           s->unit_visits + s->unit_visits_saved));
+    fprintf(f, "cell visits: %llu (%llu saved by propagation, %.1f%%)\n",
+            (unsigned long long) s->cell_visits,
+            (unsigned long long) s->cell_visits_saved,
+            _stats_percent(s->cell_visits_saved,
+                           s->cell_visits + s->cell_visits_saved));
+}
@@ -0,0 +1,60 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/* room for every entry in the strategy table (see strategy_count); strategy.c
+ * fails to compile if the table outgrows it */
+#define STATS_STRATEGIES 8
+
+/* counters for one solving strategy. an invocation is productive if it
+ * changed the board or found it inconsistent; cycles are read from the
+ * cpu's cycle counter where there is one, and clock() ticks otherwise */
+struct strategy_stats {
+    uint64_t invocations;
+    uint64_t productive;
+    uint64_t eliminated; /* pencil marks removed */
+    uint64_t filled; /* cells inked */
+    uint64_t cycles;
+};
+
+/* counters kept by the solver. a visit is one strategy looking at one unit
+ * (or, for strategies which work cell by cell, one cell); visits saved are
+ * those a full sweep of the board would have made, but which were skipped
+ * because nothing in the unit or cell had changed since the last look.
+ * nodes are the boards the search runs logic on (the starting board, and
+ * one per digit guessed), guesses are the points where the search ran out
+ * of logic and had to branch, and backtracks are the times it went back to
+ * an earlier guess after a dead end (or, when counting, after a solution).
+ *
+ * the counters are only touched when a board has a stats pointer, so they
+ * cost nothing otherwise */
+struct stats {
+    uint64_t unit_visits;
+    uint64_t unit_visits_saved;
+    uint64_t cell_visits;
+    uint64_t cell_visits_saved;
+    uint64_t nodes;
+    uint64_t guesses;
+    uint64_t backtracks;
+    uint64_t max_depth;
+    uint64_t eliminated;
+    uint64_t filled;
+    struct strategy_stats strategy[STATS_STRATEGIES];
+};
+
+void stats_reset(struct stats *s);
+void stats_add(struct stats *dst, const struct stats *src);
+void stats_print(const struct stats *s, FILE *f);
+
+static inline uint64_t stats_clock(void) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    return __builtin_ia32_rdtsc();
+#else
+    return clock();
+#endif
+}
+
+#endif
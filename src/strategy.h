@@ -2,7 +2,17 @@
 #define __STRATEGY_H__
 
 #include "cell.h"
+#include "board.h"
 
-int puzzle_logic (puzzle puz);
+int board_logic(struct board *b);
+int puzzle_logic(puzzle puz);
+
+/* the strategies board_logic runs, in order, for reporting. a disabled
+ * strategy keeps its place in the order but is never run */
+int strategy_count(void);
+const char *strategy_name(int i);
+int strategy_by_name(const char *name);
+int strategy_enabled(int i);
+void strategy_enable(int i, int on);
 
 #endif
@@ -3,6 +3,7 @@
 #include <stdint.h>
 #include <string.h>
 #include <assert.h>
+#include <time.h>
 
 #include "debug.h"
 #include "strategy.h"
@@ -11,6 +12,11 @@
 #include "constants.h"
 #include "generator.h"
 #include "interactive.h"
+#include "batch.h"
+#include "pool.h"
+#include "pseudoku.h"
+#include "serve.h"
+#include "enumerate.h"
 
 /* forward definitions */
 void puzzle_print(puzzle puz, FILE *f);
@@ -22,7 +28,10 @@ void read_and_solve (void) {
     puzzle_print(puz, stdout);
     putc('\n', stdout);
 
-    if (!puzzle_backtrack(puz)) {
+    int found = puzzle_backtrack(puz);
+    if (found == SEARCH_NO_MEMORY) {
+        printf("Out of memory\n");
+    } else if (!found) {
         printf("The puzzle is inconsistent\n");
     } else {
         puzzle_print(puz, stdout);
@@ -40,11 +49,342 @@ void test_unique(void) {
     puzzle puz;
     puzzle_read(puz, stdin);
     puzzle_pencil_possibilities(puz);
-    printf("%d solutions found\n", puzzle_solution_count(puz, 2));
+    int found = puzzle_solution_count(puz, 2);
+    if (found == SEARCH_NO_MEMORY) {
+        printf("Out of memory\n");
+    } else {
+        printf("%d solutions found\n", found);
+    }
+}
+
+/* stream puzzles in single line format from the named file, or from stdin
+ * if none is given; a named file may also be a packed corpus. --threads N
+ * solves on N worker threads, where 0 means one per online cpu, --kernel
+ * picks the hidden single kernel, --engine picks the solver engine,
+ * --enable turns on a strategy which is off by default (subsets), and
+ * --stats prints the solver's counters */
+int run_batch(enum batch_mode mode, int argc, char *argv[]) {
+    FILE *in = stdin;
+    char *path = NULL;
+    struct batch_opts opts;
+    batch_opts_init(&opts);
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--stats") == 0) {
+            opts.show_stats = 1;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            opts.threads = atoi(argv[++i]);
+            if (opts.threads <= 0) {
+                opts.threads = pool_cpu_count();
+            }
+        } else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            opts.engine = argv[++i];
+        } else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) {
+            if (pseudoku_select_kernel(argv[++i]) < 0) {
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--enable") == 0 && i + 1 < argc) {
+            if (pseudoku_enable_strategy(argv[++i]) < 0) {
+                return -1;
+            }
+        } else if (!path) {
+            path = argv[i];
+        } else {
+            return -1;
+        }
+    }
+    /* a file with the packed magic is a corpus, and is not read as text
+     * when its header or size is wrong */
+    if (path && pseudoku_corpus_sniff(path)) {
+        struct pseudoku_corpus *corpus = pseudoku_corpus_open(path);
+        if (!corpus) {
+            fprintf(stderr, "%s: damaged packed corpus\n", path);
+            return 1;
+        }
+        int res = batch_run_packed(mode, corpus, stdout, &opts);
+        pseudoku_corpus_close(corpus);
+        return res;
+    }
+    if (path) {
+        in = fopen(path, "r");
+        if (!in) {
+            perror(path);
+            return 1;
+        }
+    }
+    int res = batch_run(mode, in, stdout, &opts);
+    if (in != stdin) {
+        fclose(in);
+    }
+    return res;
+}
+
+/* serve requests (see serve.h) from --socket PATH, or from stdin if no
+ * socket is given, on --threads N worker threads (0 for one per online
+ * cpu), with the solver engine picked by --engine */
+int run_serve(int argc, char *argv[]) {
+    struct serve_opts opts;
+    serve_opts_init(&opts);
+    for (int i = 0; i < argc; i++) {
+        if (i + 1 == argc) {
+            return -1;
+        } else if (strcmp(argv[i], "--socket") == 0) {
+            opts.socket = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            opts.threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--engine") == 0) {
+            opts.engine = argv[++i];
+        } else {
+            return -1;
+        }
+    }
+    return serve(&opts);
+}
+
+/* count or enumerate the solutions of the grids in the named file, or in
+ * stdin if none is given (see enumerate.h), stopping each grid at --max N
+ * (for count) or --limit K (for enumerate) solutions, where 0 means no
+ * limit. --threads N spreads a count with no limit over N threads (0 for
+ * one per online cpu), --engine picks the solver engine for 9x9 grids,
+ * and --stats prints the solver's counters. --checkpoint FILE saves the
+ * run to FILE every --every SECS seconds (60 by default) and when it is
+ * interrupted, and --resume FILE takes it up again from there, saving to
+ * the same file unless told otherwise */
+int run_enumerate(enum enumerate_mode mode, int argc, char *argv[]) {
+    const char *limit = mode == ENUMERATE_COUNT ? "--max" : "--limit";
+    FILE *in = stdin;
+    char *path = NULL;
+    struct enumerate_opts opts;
+    enumerate_opts_init(&opts);
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--stats") == 0) {
+            opts.show_stats = 1;
+        } else if (strcmp(argv[i], limit) == 0 && i + 1 < argc) {
+            opts.limit = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            opts.threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            opts.engine = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            opts.checkpoint = argv[++i];
+        } else if (strcmp(argv[i], "--every") == 0 && i + 1 < argc) {
+            opts.every = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--resume") == 0 && i + 1 < argc) {
+            opts.resume = argv[++i];
+        } else if (!path) {
+            path = argv[i];
+        } else {
+            return -1;
+        }
+    }
+    if (opts.resume && !opts.checkpoint) {
+        opts.checkpoint = opts.resume;
+    }
+    if (path && !(in = fopen(path, "r"))) {
+        perror(path);
+        return 1;
+    }
+    int res = enumerate_run(mode, in, stdout, &opts);
+    if (in != stdin) {
+        fclose(in);
+    }
+    return res;
+}
+
+/* open the files named for pack or unpack, defaulting to stdin and stdout */
+int _open_files(int argc, char *argv[], FILE **in, const char *mode_in,
+                FILE **out, const char *mode_out) {
+    *in = stdin;
+    *out = stdout;
+    if (argc > 2) {
+        return -1;
+    }
+    if (argc > 0 && !(*in = fopen(argv[0], mode_in))) {
+        perror(argv[0]);
+        return 1;
+    }
+    if (argc > 1 && !(*out = fopen(argv[1], mode_out))) {
+        perror(argv[1]);
+        fclose(*in);
+        return 1;
+    }
+    return 0;
+}
+
+/* convert puzzles in single line format to a packed corpus. lines which
+ * are not 9x9 grids are skipped, and counted on stderr. the record count
+ * goes in the header if the output can be rewound to write it */
+int run_pack(int argc, char *argv[]) {
+    FILE *in;
+    FILE *out;
+    int res = _open_files(argc, argv, &in, "r", &out, "wb");
+    if (res) {
+        return res;
+    }
+    uint8_t header[PSEUDOKU_PACKED_HEADER];
+    uint8_t cells[PSEUDOKU_CELLS_MAX];
+    uint8_t record[PSEUDOKU_PACKED_RECORD];
+    uint64_t count = 0;
+    unsigned long skipped = 0;
+    int box;
+    pseudoku_pack_header(header, 0);
+    fwrite(header, 1, sizeof header, out);
+    while ((box = pseudoku_read(in, cells))) {
+        if (box != 3) {
+            skipped++;
+            continue;
+        }
+        pseudoku_pack(cells, record);
+        fwrite(record, 1, sizeof record, out);
+        count++;
+    }
+    if (fseek(out, 0, SEEK_SET) == 0) {
+        pseudoku_pack_header(header, count);
+        fwrite(header, 1, sizeof header, out);
+    }
+    fprintf(stderr, "%llu puzzles packed (%lu lines skipped)\n",
+            (unsigned long long) count, skipped);
+    res = ferror(out) ? 1 : 0;
+    if (in != stdin) {
+        fclose(in);
+    }
+    if (out != stdout) {
+        fclose(out);
+    }
+    return res;
+}
+
+/* write out a packed corpus in single line format */
+int run_unpack(int argc, char *argv[]) {
+    if (argc < 1 || argc > 2) {
+        return -1;
+    }
+    struct pseudoku_corpus *corpus = pseudoku_corpus_open(argv[0]);
+    if (!corpus) {
+        fprintf(stderr, "%s: not a packed corpus\n", argv[0]);
+        return 1;
+    }
+    FILE *out = argc > 1 ? fopen(argv[1], "w") : stdout;
+    if (!out) {
+        perror(argv[1]);
+        pseudoku_corpus_close(corpus);
+        return 1;
+    }
+    uint8_t cells[PSEUDOKU_CELLS_MAX];
+    char line[PSEUDOKU_LINE_MAX];
+    for (uint64_t i = 0; i < pseudoku_corpus_count(corpus); i++) {
+        if (pseudoku_unpack(pseudoku_corpus_record(corpus, i), cells)) {
+            pseudoku_format(3, cells, line);
+        } else {
+            strcpy(line, "invalid");
+        }
+        fputs(line, out);
+        putc('\n', out);
+    }
+    pseudoku_corpus_close(corpus);
+    int res = ferror(out) ? 1 : 0;
+    if (out != stdout) {
+        fclose(out);
+    }
+    return res;
+}
+
+/* write --count N new puzzles in single line format, generated on --threads
+ * T threads (0 for one per online cpu) from seeds counting up from --seed S.
+ * with --split, each puzzle's clue removal is spread over all the threads,
+ * rather than each thread generating whole puzzles. --grade LO-HI only
+ * writes puzzles graded within the band (see rating.h), with their ratings;
+ * graded generation has no split form, so it cannot be combined with
+ * --split. the output depends only on the seed and the count; without a
+ * seed, one is taken from the clock and reported on stderr, so the run can
+ * be repeated */
+int run_generate(int argc, char *argv[]) {
+    struct batch_opts opts;
+    unsigned long count = 1;
+    uint64_t seed = time(NULL);
+    int seeded = 0;
+    batch_opts_init(&opts);
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--split") == 0) {
+            opts.split = 1;
+        } else if (i + 1 == argc) {
+            return -1;
+        } else if (strcmp(argv[i], "--count") == 0) {
+            count = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--grade") == 0) {
+            if (sscanf(argv[++i], "%lf-%lf", &opts.grade_lo,
+                       &opts.grade_hi) != 2 ||
+                opts.grade_lo > opts.grade_hi) {
+                return -1;
+            }
+            opts.graded = 1;
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            seed = strtoull(argv[++i], NULL, 0);
+            seeded = 1;
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            opts.threads = atoi(argv[++i]);
+            if (opts.threads <= 0) {
+                opts.threads = pool_cpu_count();
+            }
+        } else {
+            return -1;
+        }
+    }
+    if (opts.split && opts.graded) {
+        fputs("--split cannot be combined with --grade: graded generation "
+              "runs each puzzle on one thread\n", stderr);
+        return 1;
+    }
+    if (!seeded) {
+        fprintf(stderr, "seed: %llu\n", (unsigned long long) seed);
+    }
+    return batch_generate(stdout, count, seed, &opts);
 }
 
 int main(int argc, char *argv[]) {
-    if (argc == 2) {
+    if (argc >= 3 && strcmp(argv[2], "--batch") == 0) {
+        char *command = argv[1];
+        int res = -1;
+        if (strcmp(command, "solve") == 0) {
+            res = run_batch(BATCH_SOLVE, argc - 3, argv + 3);
+        } else if (strcmp(command, "unique") == 0) {
+            res = run_batch(BATCH_UNIQUE, argc - 3, argv + 3);
+        } else if (strcmp(command, "rate") == 0) {
+            res = run_batch(BATCH_RATE, argc - 3, argv + 3);
+        }
+        if (res >= 0) {
+            return res;
+        }
+    } else if (argc >= 3 && strcmp(argv[1], "generate") == 0) {
+        int res = run_generate(argc - 2, argv + 2);
+        if (res >= 0) {
+            return res;
+        }
+    } else if (argc >= 2 && strcmp(argv[1], "serve") == 0) {
+        int res = run_serve(argc - 2, argv + 2);
+        if (res >= 0) {
+            return res;
+        }
+    } else if (argc >= 2 && strcmp(argv[1], "count") == 0) {
+        int res = run_enumerate(ENUMERATE_COUNT, argc - 2, argv + 2);
+        if (res >= 0) {
+            return res;
+        }
+    } else if (argc >= 2 && strcmp(argv[1], "enumerate") == 0) {
+        int res = run_enumerate(ENUMERATE_LIST, argc - 2, argv + 2);
+        if (res >= 0) {
+            return res;
+        }
+    } else if (argc >= 2 && strcmp(argv[1], "pack") == 0) {
+        int res = run_pack(argc - 2, argv + 2);
+        if (res >= 0) {
+            return res;
+        }
+    } else if (argc >= 2 && strcmp(argv[1], "unpack") == 0) {
+        int res = run_unpack(argc - 2, argv + 2);
+        if (res >= 0) {
+            return res;
+        }
+    } else if (argc == 2) {
         char *command = argv[1];
         if (strcmp(command, "solve") == 0) {
             read_and_solve();
@@ -60,6 +400,28 @@ int main(int argc, char *argv[]) {
             return 0;
         }
     }
-    puts("Usage: ./sudoku [solve|generate|interactive|unique]");
+    puts("Usage: ./sudoku [solve|generate|interactive|unique]\n"
+         "       ./sudoku generate --count N [--threads N] [--seed S] "
+         "[--split]\n"
+         "                         [--grade LO-HI]\n"
+         "       ./sudoku [solve|unique|rate] --batch [--threads N] "
+         "[--kernel K]\n"
+         "                                       [--engine logic|dlx] "
+         "[--enable subsets]\n"
+         "                                       [--stats] [file]\n"
+         "       ./sudoku serve [--socket PATH] [--threads N] "
+         "[--engine logic|dlx]\n"
+         "       ./sudoku count [--max N] [--threads N] [--engine logic|dlx]\n"
+         "                      [--checkpoint FILE [--every SECS]]\n"
+         "                      [--resume FILE] [--stats] [file]\n"
+         "       ./sudoku enumerate [--limit K] [--engine logic|dlx] "
+         "[--stats]\n"
+         "                          [--checkpoint FILE [--every SECS]]\n"
+         "                          [--resume FILE] [file]\n"
+         "       ./sudoku pack [in [out]]\n"
+         "       ./sudoku unpack in [out]\n"
+         "       batch input may mix 4x4, 9x9, 16x16 and 25x25 grids, "
+         "one per line,\n"
+         "       or be a packed corpus of 9x9 grids");
     return 1;
 }
@@ -0,0 +1,136 @@
+#include "units.h"
+
+const char *unit_type_names[] = { "ROW", "COL", "BOX" };
+
+/* the tables are spelled out by the preprocessor: each entry is a constant
+ * expression in the unit or cell number, and the lists below expand it once
+ * for every unit, position or cell */
+#define _UNITS(M) \
+    M(0), M(1), M(2), M(3), M(4), M(5), M(6), M(7), M(8), \
+    M(9), M(10), M(11), M(12), M(13), M(14), M(15), M(16), M(17), \
+    M(18), M(19), M(20), M(21), M(22), M(23), M(24), M(25), M(26)
+#define _ROW_CELLS(M, y) \
+    M(CELL_AT(0, y)), M(CELL_AT(1, y)), M(CELL_AT(2, y)), \
+    M(CELL_AT(3, y)), M(CELL_AT(4, y)), M(CELL_AT(5, y)), \
+    M(CELL_AT(6, y)), M(CELL_AT(7, y)), M(CELL_AT(8, y))
+#define _CELLS(M) \
+    _ROW_CELLS(M, 0), _ROW_CELLS(M, 1), _ROW_CELLS(M, 2), \
+    _ROW_CELLS(M, 3), _ROW_CELLS(M, 4), _ROW_CELLS(M, 5), \
+    _ROW_CELLS(M, 6), _ROW_CELLS(M, 7), _ROW_CELLS(M, 8)
+#define _POSITIONS(M, a) \
+    M(a, 0), M(a, 1), M(a, 2), M(a, 3), M(a, 4), M(a, 5), M(a, 6), M(a, 7), \
+    M(a, 8)
+#define _SIX(M, a) M(a, 0), M(a, 1), M(a, 2), M(a, 3), M(a, 4), M(a, 5)
+#define _TWENTY(M, a) \
+    _SIX(M, a), M(a, 6), M(a, 7), M(a, 8), M(a, 9), M(a, 10), M(a, 11), \
+    M(a, 12), M(a, 13), M(a, 14), M(a, 15), M(a, 16), M(a, 17), M(a, 18), \
+    M(a, 19)
+
+/* the p-th cell of unit u, and the position of cell c in its box */
+#define _BOX_CELL(b, p) CELL_AT((b) % 3 * 3 + (p) % 3, (b) / 3 * 3 + (p) / 3)
+#define _UNIT_CELL(u, p) \
+    ((u) < 9 ? CELL_AT(p, u) : \
+     (u) < 18 ? CELL_AT((u) - 9, p) : _BOX_CELL((u) - 18, p))
+#define _BOX_POS(c) (CELL_Y(c) % 3 * 3 + CELL_X(c) % 3)
+
+/* word w of the bitboards for a cell and for a unit */
+#define _BIT(c, w) ((c) / 64 == (w) ? 1ULL << ((c) % 64) : 0)
+#define _UNIT_WORD(u, w) \
+    (_BIT(_UNIT_CELL(u, 0), w) | _BIT(_UNIT_CELL(u, 1), w) | \
+     _BIT(_UNIT_CELL(u, 2), w) | _BIT(_UNIT_CELL(u, 3), w) | \
+     _BIT(_UNIT_CELL(u, 4), w) | _BIT(_UNIT_CELL(u, 5), w) | \
+     _BIT(_UNIT_CELL(u, 6), w) | _BIT(_UNIT_CELL(u, 7), w) | \
+     _BIT(_UNIT_CELL(u, 8), w))
+
+/* the k-th unit crossing unit u (see struct crossing); rows and columns
+ * only have three */
+#define _CROSS(u, k) \
+    ((u) < 9 ? 18 + (u) / 3 * 3 + (k) % 3 : \
+     (u) < 18 ? 18 + ((u) - 9) / 3 + (k) % 3 * 3 : \
+     (k) < 3 ? ((u) - 18) / 3 * 3 + (k) : 9 + ((u) - 18) % 3 * 3 + (k) - 3)
+#define _CROSS_WITH(u, x) \
+    { x, {{ _UNIT_WORD(u, 0) & _UNIT_WORD(x, 0), \
+            _UNIT_WORD(u, 1) & _UNIT_WORD(x, 1) }}, \
+         {{ _UNIT_WORD(x, 0) & ~_UNIT_WORD(u, 0), \
+            _UNIT_WORD(x, 1) & ~_UNIT_WORD(u, 1) }} }
+#define _CROSSING(u, k) _CROSS_WITH(u, _CROSS(u, k))
+
+/* the k-th of the 20 peers of cell c: the rest of its row, the rest of its
+ * column, then the four cells of its box in neither */
+#define _SKIP(k, v) ((k) < (v) ? (k) : (k) + 1)
+#define _PEER(c, k) \
+    ((k) < 8 ? CELL_AT(_SKIP(k, CELL_X(c)), CELL_Y(c)) : \
+     (k) < 16 ? CELL_AT(CELL_X(c), _SKIP((k) - 8, CELL_Y(c))) : \
+     CELL_AT(CELL_X(c) / 3 * 3 + _SKIP((k) % 2, CELL_X(c) % 3), \
+             CELL_Y(c) / 3 * 3 + _SKIP(((k) - 16) / 2, CELL_Y(c) % 3)))
+
+#define _UNIT_CELLS(u) { _POSITIONS(_UNIT_CELL, u) }
+#define _UNIT_BB(u) {{ _UNIT_WORD(u, 0), _UNIT_WORD(u, 1) }}
+#define _UNIT_CROSSINGS(u) { _SIX(_CROSSING, u) }
+#define _CELL_UNITS(c) { CELL_Y(c), 9 + CELL_X(c), 18 + CELL_BOX(c) }
+#define _CELL_UNIT_BITS(c) \
+    (1UL << CELL_Y(c) | 1UL << (9 + CELL_X(c)) | 1UL << (18 + CELL_BOX(c)))
+#define _CELL_PEERS(c) { _TWENTY(_PEER, c) }
+#define _PEER_WORD(c, w) \
+    ((_UNIT_WORD(CELL_Y(c), w) | _UNIT_WORD(9 + CELL_X(c), w) | \
+      _UNIT_WORD(18 + CELL_BOX(c), w)) & ~_BIT(c, w))
+#define _PEER_BB(c) {{ _PEER_WORD(c, 0), _PEER_WORD(c, 1) }}
+#define _CELL_LANES(c) \
+    { CELL_X(c) * LANE_UNITS + CELL_Y(c), \
+      CELL_Y(c) * LANE_UNITS + 9 + CELL_X(c), \
+      _BOX_POS(c) * LANE_UNITS + 18 + CELL_BOX(c) }
+
+const uint8_t unit_cells[UNIT_COUNT][9] = { _UNITS(_UNIT_CELLS) };
+const struct bitboard unit_bb[UNIT_COUNT] = { _UNITS(_UNIT_BB) };
+const struct crossing unit_crossings[UNIT_COUNT][CROSSING_MAX] = {
+    _UNITS(_UNIT_CROSSINGS)
+};
+const uint8_t cell_units[BOARD_LENGTH][3] = { _CELLS(_CELL_UNITS) };
+const uint32_t cell_unit_bits[BOARD_LENGTH] = { _CELLS(_CELL_UNIT_BITS) };
+const uint8_t cell_peers[BOARD_LENGTH][PEER_COUNT] = { _CELLS(_CELL_PEERS) };
+const struct bitboard peer_bb[BOARD_LENGTH] = { _CELLS(_PEER_BB) };
+const uint16_t cell_lanes[BOARD_LENGTH][3] = { _CELLS(_CELL_LANES) };
+
+/* the digits inked in unit u */
+uint16_t unit_inked(puzzle puz, int u) {
+    uint16_t inked = 0;
+    for (int p = 0; p < 9; p++) {
+        struct cell *c = unit_cell(puz, u, p);
+        if (c->complete) {
+            inked |= ink_to_pencil(c->u.ink);
+        }
+    }
+    return inked;
+}
+
+/* pencil the digits in mask out of the incomplete cells of unit u */
+int unit_mask(puzzle puz, int u, uint16_t mask) {
+    int change = 0;
+    for (int p = 0; p < 9; p++) {
+        struct cell *c = unit_cell(puz, u, p);
+        if (!c->complete) {
+            change = change || (mask & c->u.pencil);
+            c->u.pencil &= ~mask;
+            if (!c->u.pencil) {
+                return INCONSISTENT;
+            }
+        }
+    }
+    return change ? CHANGE : NO_CHANGE;
+}
+
+/* whether no digit is inked twice in unit u */
+int unit_consistent(puzzle puz, int u) {
+    uint16_t seen = 0;
+    for (int p = 0; p < 9; p++) {
+        struct cell *c = unit_cell(puz, u, p);
+        if (c->complete) {
+            uint16_t here = ink_to_pencil(c->u.ink);
+            if (seen & here) {
+                return 0;
+            }
+            seen |= here;
+        }
+    }
+    return 1;
+}
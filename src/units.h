@@ -0,0 +1,72 @@
+#ifndef __UNITS_H__
+#define __UNITS_H__
+
+#include <stdint.h>
+
+#include "cell.h"
+#include "constants.h"
+
+/* the geometry of the 9x9 grid. cells are numbered in row major order, so
+ * cell i is grid[i % 9][i / 9], and unit u is number u % 9 of unit_type
+ * u / 9: rows are units 0 to 8, columns 9 to 17 and boxes 18 to 26. the
+ * p-th cell of a box counts across and then down from its top left.
+ *
+ * everything here is a constant table, worked out by the compiler (see
+ * units.c), so walking a unit or a cell's peers costs a load per cell
+ * instead of a division and a branch */
+enum unit_type { ROW, COL, BOX };
+extern const char *unit_type_names[];
+
+#define UNIT_COUNT 27
+#define PEER_COUNT 20
+#define LANE_UNITS 32 /* UNIT_COUNT, padded to a whole number of vectors */
+#define ALL_UNITS ((1UL << UNIT_COUNT) - 1)
+#define CELL_X(c) ((c) % 9)
+#define CELL_Y(c) ((c) / 9)
+#define CELL_AT(x, y) ((y) * 9 + (x))
+#define CELL_BOX(c) ((CELL_Y(c) / 3) * 3 + CELL_X(c) / 3)
+
+/* a set of cells, one bit per cell: cell i is bit i % 64 of word i / 64 */
+struct bitboard {
+    uint64_t w[2];
+};
+
+/* where a unit meets one of the units crossing it: a row or column is
+ * crossed by the three boxes it passes through, and a box by the three
+ * rows of its band and then the three columns of its stack. inside is the
+ * three cells the two have in common, and outside is the rest of the
+ * crossing unit */
+#define CROSSING_MAX 6
+#define CROSSINGS(u) ((u) / 9 == BOX ? 6 : 3)
+
+struct crossing {
+    uint8_t unit;
+    struct bitboard inside;
+    struct bitboard outside;
+};
+
+extern const uint8_t unit_cells[UNIT_COUNT][9];
+extern const struct bitboard unit_bb[UNIT_COUNT];
+extern const struct crossing unit_crossings[UNIT_COUNT][CROSSING_MAX];
+extern const uint8_t cell_units[BOARD_LENGTH][3];
+extern const uint32_t cell_unit_bits[BOARD_LENGTH];
+extern const uint8_t cell_peers[BOARD_LENGTH][PEER_COUNT];
+extern const struct bitboard peer_bb[BOARD_LENGTH];
+/* where each cell sits in a board's lanes (see board.h), by unit type */
+extern const uint16_t cell_lanes[BOARD_LENGTH][3];
+
+static inline struct cell *unit_cell(puzzle puz, int u, int p) {
+    int i = unit_cells[u][p];
+    return &puz[CELL_X(i)][CELL_Y(i)];
+}
+
+static inline struct cell *peer_cell(puzzle puz, int cell, int p) {
+    int i = cell_peers[cell][p];
+    return &puz[CELL_X(i)][CELL_Y(i)];
+}
+
+uint16_t unit_inked(puzzle puz, int u);
+int unit_mask(puzzle puz, int u, uint16_t mask);
+int unit_consistent(puzzle puz, int u);
+
+#endif